@@ -51,7 +51,9 @@ int main(int argc, char** argv)
 
 		// Uncomment the config value below to allow unrecognized opts on the
 		// command line starting from this point. config::passThrough is
-		// useful for creating modular getopt calls.
+		// useful for creating modular getopt calls, though modules that each
+		// define their own options are better served by GetOpt::ParseSession,
+		// which shares one pass over the args between them.
 		// 
 		/*, GetOpt::config::passThrough*/
 		//
@@ -0,0 +1,293 @@
+/**
+ * Demo: batchvalidate.cpp
+ * Purpose: Validates a file of command lines, one per line, against a tool's
+ * compiled option schema (see GetOpt::writeOptionSchema), in parallel.
+ *
+ * Usage:
+ *   batchvalidate [-j threads] <schema> <command lines> <status output>
+ *   batchvalidate --write-example-schema <schema>
+ *
+ * The status output holds one character per input line, each followed by a
+ * newline:
+ *   .  valid
+ *   U  unrecognized option
+ *   V  option is missing its value
+ *   T  value does not convert to the option's type
+ *   Q  unterminated quote or trailing backslash
+ *
+ * Each line is a whole command line, program name first, split with
+ * GetOpt::splitCommandLine. Options are checked against the schema the way
+ * getopt's defaults would see them: case-insensitively, without bundling,
+ * one option at a time in the order they were declared, with everything
+ * after "--" left alone (see batchvalidate.h). Like getopt, a line asking for
+ * help is valid whatever else it holds, and values must convert to the type
+ * and width of the variable the option was bound to.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#include "batchvalidate.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BATCHVALIDATE_MMAP
+#endif
+
+using namespace std;
+using GetOpt::OptionSchema;
+using GetOpt::StringView;
+
+// The whole input, mapped where the platform allows it
+class InputFile
+{
+	const char* bytes = nullptr;
+	size_t length = 0;
+	string fallback;
+#ifdef BATCHVALIDATE_MMAP
+	void* mapping = nullptr;
+#endif
+public:
+	explicit InputFile(const string& path)
+	{
+#ifdef BATCHVALIDATE_MMAP
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if(fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			length = static_cast<size_t>(st.st_size);
+			mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(mapping == MAP_FAILED)
+				mapping = nullptr;
+			else
+			{
+				madvise(mapping, length, MADV_SEQUENTIAL);
+				bytes = static_cast<const char*>(mapping);
+			}
+		}
+		if(fd >= 0)
+			close(fd);
+		if(mapping)
+			return;
+		length = 0;
+#endif
+		ifstream file(path, ios::binary);
+		if(!file)
+			throw runtime_error("Cannot open " + path);
+		fallback.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+		bytes = fallback.data();
+		length = fallback.size();
+	}
+	~InputFile()
+	{
+#ifdef BATCHVALIDATE_MMAP
+		if(mapping)
+			munmap(mapping, length);
+#endif
+	}
+	InputFile(const InputFile&) = delete;
+	InputFile& operator=(const InputFile&) = delete;
+
+	const char* data() const { return bytes; }
+	size_t size() const { return length; }
+};
+
+vector<StringView> splitLines(const char* data, size_t size)
+{
+	vector<StringView> lines;
+	const char* end = data + size;
+	while(data < end)
+	{
+		auto newline = static_cast<const char*>(memchr(data, '\n', end - data));
+		auto lineEnd = newline ? newline : end;
+		auto contentEnd = (lineEnd > data && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd;
+		lines.push_back(StringView(data, contentEnd - data));
+		data = lineEnd + 1;
+	}
+	return lines;
+}
+
+// Work-stealing pool over line indices. Each worker owns a range packed into
+// one atomic word; it takes small chunks off the front of its own range and,
+// once that is empty, steals the back half of another worker's.
+class WorkStealingRanges
+{
+	struct Range
+	{
+		atomic<uint64_t> bounds;
+		char padding[64 - sizeof(atomic<uint64_t>)]; // One cache line per worker
+	};
+	unique_ptr<Range[]> ranges;
+	size_t workers;
+
+	static uint64_t pack(uint32_t begin, uint32_t end) { return (uint64_t(begin) << 32) | end; }
+	static uint32_t begin(uint64_t r) { return uint32_t(r >> 32); }
+	static uint32_t end(uint64_t r) { return uint32_t(r); }
+
+public:
+	static const uint32_t chunk = 256;
+
+	WorkStealingRanges(size_t n, size_t items)
+		: ranges(new Range[n]), workers(n)
+	{
+		for(size_t w = 0; w < n; ++w)
+			ranges[w].bounds = pack(uint32_t(items * w / n), uint32_t(items * (w + 1) / n));
+	}
+
+	// Claims the next chunk for @worker into [first, last); false when all work is done
+	bool next(size_t worker, uint32_t& first, uint32_t& last)
+	{
+		auto& own = ranges[worker].bounds;
+		uint64_t r = own.load();
+		while(begin(r) < end(r))
+		{
+			uint32_t take = min<uint32_t>(chunk, end(r) - begin(r));
+			if(own.compare_exchange_weak(r, pack(begin(r) + take, end(r))))
+			{
+				first = begin(r);
+				last = begin(r) + take;
+				return true;
+			}
+		}
+		for(size_t i = 1; i < workers; ++i)
+		{
+			auto& victim = ranges[(worker + i) % workers].bounds;
+			uint64_t v = victim.load();
+			while(end(v) - begin(v) > chunk)
+			{
+				uint32_t middle = begin(v) + (end(v) - begin(v)) / 2;
+				if(victim.compare_exchange_weak(v, pack(begin(v), middle)))
+				{
+					// Keep the first chunk of the stolen half, publish the rest
+					first = middle;
+					last = min(middle + chunk, end(v));
+					own.store(pack(last, end(v)));
+					return true;
+				}
+			}
+			while(begin(v) < end(v))// Too small to split; take it from the front
+			{
+				if(victim.compare_exchange_weak(v, pack(end(v), end(v))))
+				{
+					first = begin(v);
+					last = end(v);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+};
+const uint32_t WorkStealingRanges::chunk;
+
+void writeExampleSchema(const string& path)
+{
+	string data, color;
+	int length = 0, verbosity = 0;
+	bool pretty = false;
+	auto result = GetOpt::collectOptions(
+		"l|length", &length, "file|f", &data, "verbose|v+", &verbosity
+		, "color|c|colour", &color, "pretty|p", &pretty);
+	ofstream file(path, ios::binary);
+	GetOpt::writeOptionSchema(file, result.options);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned threads = thread::hardware_concurrency();
+	string exampleSchema;
+	GetOpt::GetOptResultAndArgs results;
+	try
+	{
+		results = GetOpt::getopt(argc, argv
+			, "threads|j", "Worker threads (default: one per core)", &threads
+			, "write-example-schema", "Write a schema for example/basic.cpp's options and exit", &exampleSchema);
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cerr << e.what() << endl;
+		return 1;
+	}
+	if(results.result.helpWanted)
+	{
+		defaultGetoptPrinter("Usage: batchvalidate [options] <schema> <command lines> <status output>", results.result.options);
+		return 0;
+	}
+	if(!exampleSchema.empty())
+	{
+		writeExampleSchema(exampleSchema);
+		return 0;
+	}
+	if(results.args.size() != 4)
+	{
+		cerr << "Expected <schema> <command lines> <status output>; see --help" << endl;
+		return 1;
+	}
+	threads = max(threads, 1u);
+
+	try
+	{
+		InputFile schemaFile(results.args[1]);
+		OptionSchema schema(schemaFile.data(), schemaFile.size());
+		InputFile input(results.args[2]);
+
+		auto started = chrono::steady_clock::now();
+		auto lines = splitLines(input.data(), input.size());
+		if(lines.size() > UINT32_MAX)
+			throw runtime_error("Too many lines");
+		string status(lines.size() * 2, '\n');
+		WorkStealingRanges work(threads, lines.size());
+		vector<thread> pool;
+		for(unsigned w = 0; w < threads; ++w)
+			pool.emplace_back([&, w]()
+			{
+				GetOpt::CommandLine words;
+				BatchValidate::Scratch scratch;
+				uint32_t first, last;
+				while(work.next(w, first, last))
+					for(auto i = first; i < last; ++i)
+					{
+						try
+						{
+							GetOpt::splitCommandLine(lines[i], words);
+						}
+						catch(GetOpt::GetOptException&)
+						{
+							status[2 * i] = 'Q';
+							continue;
+						}
+						status[2 * i] = BatchValidate::validate(schema, words, scratch);
+					}
+			});
+		for(auto& t : pool)
+			t.join();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+		ofstream output(results.args[3], ios::binary);
+		output.write(status.data(), status.size());
+		if(!output)
+			throw runtime_error("Cannot write " + results.args[3]);
+		auto invalid = lines.size() - count(status.begin(), status.end(), '.');
+		cerr << lines.size() << " lines, " << invalid << " invalid, "
+			<< threads << " threads, " << size_t(lines.size() / max(seconds, 1e-9)) << " lines/s" << endl;
+	}
+	catch(exception& e)
+	{
+		cerr << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
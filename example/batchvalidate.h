@@ -0,0 +1,182 @@
+/**
+ * batchvalidate.h
+ * Purpose: Checks one command line, split into words, against a compiled
+ * option schema the way getopt's defaults would check it. Shared by the
+ * batchvalidate demo and the test harness, which holds it to getopt's own
+ * verdicts.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#ifndef BATCHVALIDATE_H
+#define BATCHVALIDATE_H
+
+#include "../include/getopt.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace BatchValidate
+{
+	using GetOpt::OptionSchema;
+	using GetOpt::StringView;
+
+	// Whether getopt's own conversion to @T accepts @value
+	template<typename T>
+	bool assigns(const std::string& value)
+	{
+		T t;
+		try
+		{
+			GetOpt::getoptassign(&t, value);
+		}
+		catch(GetOpt::GetOptException&)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	bool parses(const std::string& value)
+	{
+		T t;
+		return GetOpt::parseIntegral(StringView(value), t);
+	}
+
+	// Whether @value converts to the variable @entry is bound to, as getopt would convert it
+	inline bool convertsTo(const OptionSchema::Entry& entry, const std::string& value)
+	{
+		bool isSigned = entry.valueSigned();
+		switch(entry.type())
+		{
+			case GetOpt::ValueType::boolean:
+				return assigns<bool>(value);
+			case GetOpt::ValueType::integral:
+				switch(entry.valueSize())
+				{
+					case 1:
+						return assigns<char>(value);
+					case 2:
+						return isSigned ? parses<int16_t>(value) : parses<uint16_t>(value);
+					case 4:
+						return isSigned ? parses<int32_t>(value) : parses<uint32_t>(value);
+					default:
+						return isSigned ? parses<int64_t>(value) : parses<uint64_t>(value);
+				}
+			case GetOpt::ValueType::floating:
+				switch(entry.valueSize())
+				{
+					case sizeof(float):
+						return assigns<float>(value);
+					case sizeof(double):
+						return assigns<double>(value);
+					default:
+						return assigns<long double>(value);
+				}
+			default:
+				return true;
+		}
+	}
+
+	// Storage reused across lines by one worker
+	struct Scratch
+	{
+		std::string word;
+		std::string content;
+		std::vector<size_t> options; // Per word: the option it names, or npos
+		std::vector<GetOpt::FlagType> types;
+		std::vector<bool> taken;
+	};
+
+	// @words[@i] as getopt's default sees it: case-insensitively. Leaves the
+	// option's name in @s.word and any attached value in @s.content.
+	inline GetOpt::FlagType classify(const GetOpt::CommandLine& words, size_t i, Scratch& s)
+	{
+		s.word.assign(words[i].data(), words[i].size());
+		std::transform(s.word.begin(), s.word.end(), s.word.begin(), ::tolower);
+		return GetOpt::flagType(s.word, s.content);
+	}
+
+	// Whether getopt would answer help for these words before validating any
+	// of them: "--help" always does, "-h" when it belongs to the help option
+	inline bool wantsHelp(const OptionSchema& schema, const GetOpt::CommandLine& words, size_t end, Scratch& s)
+	{
+		for(size_t i = 1; i < end; ++i)
+		{
+			s.word.assign(words[i].data(), words[i].size());
+			std::transform(s.word.begin(), s.word.end(), s.word.begin(), ::tolower);
+			if(s.word == "--help" || (s.word == "-h" && schema.findShort('h') == schema.findLong("help")))
+				return true;
+		}
+		return false;
+	}
+
+	// Status of one command line:
+	//   .  valid
+	//   U  unrecognized option
+	//   V  option is missing its value
+	//   T  value does not convert to the option's type
+	// As getopt does, each option in turn, in schema record order, takes its
+	// occurrences from the words before "--" that no earlier option took, a
+	// solitary one with the next such word as its value; then any option word
+	// left over is unrecognized. Which option a word names never changes, so
+	// each word is looked up once.
+	inline char validate(const OptionSchema& schema, const GetOpt::CommandLine& words, Scratch& s)
+	{
+		size_t end = 1;
+		while(end < words.size() && words[end] != "--")
+			++end;
+		if(wantsHelp(schema, words, end, s))
+			return '.';
+		s.options.assign(end, OptionSchema::npos);
+		s.types.assign(end, GetOpt::FlagType::NONE);
+		s.taken.assign(end, false);
+		for(size_t i = 1; i < end; ++i)
+		{
+			auto type = classify(words, i, s);
+			s.types[i] = type;
+			if(type == GetOpt::FlagType::LONG || type == GetOpt::FlagType::LONG_SOLITARY)
+				s.options[i] = schema.findLong(s.word);
+			else if(type != GetOpt::FlagType::NONE)
+				s.options[i] = schema.findShort(s.word[0]);
+		}
+
+		for(size_t option = 0; option < schema.size(); ++option)
+		{
+			auto entry = schema[option];
+			bool takesValue = entry.type() != GetOpt::ValueType::boolean && !entry.isIncremental();
+			for(size_t i = 1; i < end; ++i)
+			{
+				if(s.taken[i] || s.options[i] != option)
+					continue;
+				s.taken[i] = true;
+				auto type = s.types[i];
+				if(type == GetOpt::FlagType::LONG_SOLITARY || type == GetOpt::FlagType::SHORT_SOLITARY)
+				{
+					if(!takesValue)
+						continue;
+					size_t next = i + 1;
+					while(next < end && s.taken[next])
+						++next;
+					if(next == end)
+						return 'V';
+					s.taken[next] = true;
+					s.content.assign(words[next].data(), words[next].size());
+				}
+				else
+					classify(words, i, s);
+				if(!convertsTo(entry, s.content))
+					return 'T';
+			}
+		}
+
+		for(size_t i = 1; i < end; ++i)
+			if(!s.taken[i] && s.types[i] != GetOpt::FlagType::NONE)
+				return 'U';
+		return '.';
+	}
+}
+
+#endif
@@ -33,13 +33,21 @@
  */
 
 // Core functionality
+#include <cstdint> // fixed-width fields of serialized schemas
+#include <cstdio> // snprintf, for fingerprints of floating point values
+#include <cstring> // strlen, strcmp, memcpy
 #include <iostream>// ostream for help printing
 #include <sstream> // conversions between most types
 #include <stdexcept> // runtime_error
 #include <string>
 #include <type_traits> // is_integral, // remove_const
 #include <typeinfo> // use typeid(...) for error message for conversions
+#include <unordered_map> // result indexing
 #include <unordered_set> // opts matching
+#include <array>
+#include <chrono> // duration options
+#include <initializer_list> // choice tables
+#include <limits> // integral conversion bounds
 #include <utility> // move
 #include <vector>
 
@@ -53,6 +61,16 @@
 // Help printing
 #include <iomanip>
 
+// Command line splitting
+#include <deque> // storage that stays put for unescaped words
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define GETOPT_SSE2
+#endif
+
+// Shell completion
+#include <cstdlib> // exit, strtoul
+
 namespace GetOpt // The namespace for everything associated with this library.
 {
 	class GetOptException : public std::runtime_error
@@ -61,6 +79,40 @@ namespace GetOpt // The namespace for everything associated with this library.
 		GetOptException(const std::string& s) : std::runtime_error(s){}
 	};
 
+	// Non-owning view of a run of characters (std::string_view needs C++17)
+	class StringView
+	{
+		const char* d = nullptr;
+		size_t n = 0;
+	public:
+		StringView() = default;
+		StringView(const char* data, size_t size) : d(data), n(size){}
+		StringView(const char* s) : d(s), n(std::strlen(s)){}
+		StringView(const std::string& s) : d(s.data()), n(s.size()){}
+
+		const char* data() const { return d; }
+		size_t size() const { return n; }
+		bool empty() const { return n == 0; }
+		const char* begin() const { return d; }
+		const char* end() const { return d + n; }
+		char operator[](size_t i) const { return d[i]; }
+		std::string str() const { return std::string(d, n); }
+
+		int compare(StringView v) const
+		{
+			int c = (n && v.n) ? std::memcmp(d, v.d, n < v.n ? n : v.n) : 0;
+			return c ? c : (n < v.n ? -1 : (n > v.n ? 1 : 0));
+		}
+		bool operator==(StringView v) const { return n == v.n && compare(v) == 0; }
+		bool operator!=(StringView v) const { return !(*this == v); }
+		bool operator<(StringView v) const { return compare(v) < 0; }
+
+		friend std::ostream& operator<<(std::ostream& os, StringView v)
+		{
+			return os.write(v.d, v.n);
+		}
+	};
+
 	// Conforms to [D's config values](http://dlang.org/phobos/std_getopt.html#.config)
 	enum class config
 	{
@@ -73,6 +125,10 @@ namespace GetOpt // The namespace for everything associated with this library.
 		stopOnFirstNonOption,
 		keepEndOfOptions,
 		required,
+		excludeFromFingerprint, // Nonstandard; like required, affects the next option only
+		keepTailInPlace, // Nonstandard; see ArgRange
+		validateUtf8, // Nonstandard; see "UTF-8 validation"
+		replaceInvalidUtf8, // Nonstandard; see "UTF-8 validation"
 	};
 
 	class GetOptConfiguration
@@ -84,6 +140,13 @@ namespace GetOpt // The namespace for everything associated with this library.
 		bool keepEndOfOptions = false;
 		bool caseSensitive = false;
 		bool stopOnFirstNonOption = false;
+		bool excludeFromFingerprint = false;
+		bool keepTailInPlace = false;
+		bool validateUtf8 = false;
+		bool replaceInvalidUtf8 = false;
+
+		// Nonstandard: only build the option specs, leaving args untouched
+		bool collectOnly = false;
 
 		void set(config configOption)
 		{
@@ -116,10 +179,43 @@ namespace GetOpt // The namespace for everything associated with this library.
 				case config::stopOnFirstNonOption:
 					this->stopOnFirstNonOption = true;
 					break;
+				case config::excludeFromFingerprint:
+					this->excludeFromFingerprint = true;
+					break;
+				case config::keepTailInPlace:
+					this->keepTailInPlace = true;
+					break;
+				case config::validateUtf8:
+					this->validateUtf8 = true;
+					break;
+				case config::replaceInvalidUtf8:
+					this->replaceInvalidUtf8 = true;
+					break;
 			}
 		}
 	};
 
+	// Coarse type of the variable an option is bound to
+	enum class ValueType : uint8_t
+	{
+		other,
+		boolean,
+		integral,
+		floating,
+		string,
+	};
+
+	template<typename T>
+	ValueType valueTypeOf()
+	{
+		typedef typename std::remove_cv<typename std::remove_pointer<T>::type>::type V;
+		return std::is_same<V, bool>::value ? ValueType::boolean
+			: std::is_integral<V>::value ? ValueType::integral
+			: std::is_floating_point<V>::value ? ValueType::floating
+			: std::is_same<V, std::string>::value ? ValueType::string
+			: ValueType::other;
+	}
+
 	class Option
 	{
 	private:
@@ -127,10 +223,15 @@ namespace GetOpt // The namespace for everything associated with this library.
 			: shortOpts(sos), longOpts(los){}
 	public:
 		bool isIncremental = false;
+		bool excludedFromFingerprint = false;
+		ValueType type = ValueType::other;
+		uint8_t valueSize = 0; // Bytes in the bound variable, for integral and floating types
+		bool valueSigned = false;
 		std::string spec;
 		std::string help;
 		std::string longOptForHelp;
 		std::string shortOptForHelp;
+		std::string choices; // Valid values, '|'-separated, for enumerated options
 		std::unordered_set<char> shortOpts;
 		std::unordered_set<std::string> longOpts;
 
@@ -185,6 +286,96 @@ namespace GetOpt // The namespace for everything associated with this library.
 			this->shortOpts = std::move(shortOpts);
 			this->longOpts = std::move(longOpts);
 		}
+
+		// Whether the option reads a value when given alone, as "-o VALUE"
+		bool takesValue() const
+		{
+			return type != ValueType::boolean && !isIncremental;
+		}
+	};
+
+	// Describes the variable that @option binds to through a @T target
+	template<typename T>
+	void describeValue(Option& option)
+	{
+		typedef typename std::remove_cv<typename std::remove_pointer<T>::type>::type V;
+		typedef typename std::conditional<std::is_arithmetic<V>::value, V, char>::type Arithmetic;
+		option.type = valueTypeOf<T>();
+		bool numeric = option.type == ValueType::integral || option.type == ValueType::floating;
+		option.valueSize = numeric ? static_cast<uint8_t>(sizeof(Arithmetic)) : 0;
+		option.valueSigned = numeric && std::is_signed<Arithmetic>::value;
+	}
+
+	// A 128-bit hash, as two independent 64-bit lanes. Fingerprints combine by
+	// addition, so a sum of them doesn't depend on the order of its terms.
+	struct Fingerprint
+	{
+		uint64_t low = 0;
+		uint64_t high = 0;
+
+		static Fingerprint start()
+		{
+			Fingerprint f;
+			f.low = 0xcbf29ce484222325ULL;
+			f.high = 0x84222325cbf29ce4ULL;
+			return f;
+		}
+
+		// Continues the hash over @size bytes at @data (xor-multiply, as FNV-1a)
+		Fingerprint& feed(const char* data, size_t size)
+		{
+			for(size_t i = 0; i < size; ++i)
+			{
+				auto byte = static_cast<unsigned char>(data[i]);
+				low = (low ^ byte) * 0x100000001b3ULL;
+				high = (high ^ byte) * 0x9e3779b97f4a7c15ULL;
+			}
+			return *this;
+		}
+		// Continues the hash over @f, independently of byte order
+		Fingerprint& feed(const Fingerprint& f)
+		{
+			char bytes[16];
+			for(int i = 0; i < 8; ++i)
+			{
+				bytes[i] = static_cast<char>(f.low >> (8 * i));
+				bytes[8 + i] = static_cast<char>(f.high >> (8 * i));
+			}
+			return feed(bytes, sizeof(bytes));
+		}
+
+		// Avalanches both lanes (MurmurHash3's finalizer), so that sums of
+		// fingerprints stay well distributed
+		Fingerprint finished() const
+		{
+			auto mix = [](uint64_t h)
+			{
+				h ^= h >> 33;
+				h *= 0xff51afd7ed558ccdULL;
+				h ^= h >> 33;
+				h *= 0xc4ceb9fe1a85ec53ULL;
+				return h ^ (h >> 33);
+			};
+			Fingerprint f;
+			f.low = mix(low);
+			f.high = mix(high);
+			return f;
+		}
+
+		Fingerprint& operator+=(const Fingerprint& f)
+		{
+			low += f.low;
+			high += f.high;
+			return *this;
+		}
+		Fingerprint& operator-=(const Fingerprint& f)
+		{
+			low -= f.low;
+			high -= f.high;
+			return *this;
+		}
+		bool operator==(const Fingerprint& f) const { return low == f.low && high == f.high; }
+		bool operator!=(const Fingerprint& f) const { return !(*this == f); }
 	};
 
 	struct GetOptResult
@@ -193,42 +384,449 @@ namespace GetOpt // The namespace for everything associated with this library.
 		std::vector<Option> options;
 		bool helpWanted = false;
 
-		// Nonstandard
+		// Nonstandard: false once parsing stopped at a non-option, with config::stopOnFirstNonOption
 		bool parsing = true;
 
-		GetOptResult() = default;
-		// TODO: Define move semantics
-		// Problem: Was getting error with the following commented out:
-		// GetOptResult(GetOptResult&& r)
-		// 	: options(std::move(r.options))
-		// 	, helpWanted(r.helpWanted)
-		// 	, parsing(r.parsing)
-		// {}
-		// GetOptResult operator=(GetOptResult&& r)
-		// {
-		// 	this->options = std::move(r.options);
-		// 	this->helpWanted = r.helpWanted;
-		// 	this->parsing = r.parsing;
-		// }
-
-		bool definedOption(const std::string& s)
+		// Nonstandard: canonical fingerprint of the options parsed, kept up to
+		// date during the parse. It covers each option's spec and normalized
+		// effective value, not the order or spelling of args, which makes it a
+		// cache key for the effective configuration. Options given after
+		// config::excludeFromFingerprint don't count.
+		Fingerprint fingerprint;
+
+		// An enumerator, so that it never needs an out-of-line definition
+		enum : size_t { npos = static_cast<size_t>(-1) };
+
+		// What the parse saw of one option
+		struct OptionUsage
+		{
+			size_t count = 0;
+			std::string lastValue; // Empty if the last use took no value
+			std::vector<size_t> positions; // Indices into args as originally given
+			Fingerprint valueHash, contribution; // This option's share of fingerprint
+		};
+
+		// Parallel to options. An option's id is its index in both: the order
+		// it was given to getopt in, with the builtin help last. Ids are fixed
+		// by the call site, so they serve as compile-time handles.
+		std::vector<OptionUsage> usages;
+
+		GetOptResult()
+		{
+			shortIndex.fill(npos);
+		}
+		// Moving a result takes its options, indexes and usages as they are
+		GetOptResult(GetOptResult&&) = default;
+		GetOptResult& operator=(GetOptResult&&) = default;
+		GetOptResult(const GetOptResult&) = default;
+		GetOptResult& operator=(const GetOptResult&) = default;
+
+		// Id of the option defining @s, or npos
+		size_t optionId(const std::string& s) const
 		{
 			if(s.size() == 1)
-				return definedOption(s[0]);
-			for(auto& o : options)
-				if(o.longOpts.count(s))
-					return true;
-			return false;
+				return optionId(s[0]);
+			auto found = longIndex.find(s);
+			return found == longIndex.end() ? npos : found->second;
 		}
-		bool definedOption(const char c)
+		size_t optionId(const char c) const
 		{
-			for(auto& o : options)
-				if(o.shortOpts.count(c))
-					return true;
-			return false;
+			return shortIndex[static_cast<unsigned char>(c)];
+		}
+
+		const OptionUsage& usage(size_t id) const
+		{
+			return usages[id];
+		}
+
+		bool definedOption(const std::string& s) const
+		{
+			return optionId(s) != npos;
+		}
+		bool definedOption(const char c) const
+		{
+			return optionId(c) != npos;
+		}
+
+		// Whether the option defining @s was found in args
+		bool seen(const std::string& s) const
+		{
+			auto id = optionId(s);
+			return id != npos && usages[id].count > 0;
+		}
+		bool seen(const char c) const
+		{
+			auto id = optionId(c);
+			return id != npos && usages[id].count > 0;
+		}
+
+		// Appends @option, indexing its names; the first option to define a
+		// name owns it
+		size_t addOption(Option option)
+		{
+			options.push_back(std::move(option));
+			return indexLastOption();
+		}
+
+		// As addOption, constructing the option in place from @optionArgs
+		template<typename...OptionArgs>
+		size_t emplaceOption(OptionArgs&&...optionArgs)
+		{
+			options.emplace_back(std::forward<OptionArgs>(optionArgs)...);
+			return indexLastOption();
+		}
+
+		// Records a use of option @id found at @position in args as given
+		void recordUse(size_t id, size_t position)
+		{
+			auto& u = usages[id];
+			++u.count;
+			u.lastValue.clear();
+			u.positions.push_back(position);
+		}
+
+		// Folds the normalized @value just given to option @id into fingerprint;
+		// @accumulate keeps earlier values (as sinks do) instead of replacing them
+		void fingerprintUse(size_t id, const std::string& value, bool accumulate)
+		{
+			auto& option = options[id];
+			if(option.excludedFromFingerprint)
+				return;
+			auto& u = usages[id];
+			if(accumulate && u.count > 1)
+				u.valueHash.feed("", 1);
+			else
+				u.valueHash = Fingerprint::start();
+			u.valueHash.feed(value.data(), value.size());
+			fingerprint -= u.contribution;
+			u.contribution = Fingerprint::start().feed(option.spec.data(), option.spec.size() + 1)
+				.feed(u.valueHash).finished();
+			fingerprint += u.contribution;
+		}
+
+	private:
+		std::unordered_map<std::string, size_t> longIndex;
+		std::array<size_t, 256> shortIndex;
+
+		size_t indexLastOption()
+		{
+			auto id = options.size() - 1;
+			auto& option = options.back();
+			usages.emplace_back();
+			for(auto c : option.shortOpts)
+				if(shortIndex[static_cast<unsigned char>(c)] == npos)
+					shortIndex[static_cast<unsigned char>(c)] = id;
+			for(auto& l : option.longOpts)
+				longIndex.insert(std::make_pair(l, id));
+			return id;
+		}
+	};
+
+	// Compiled option schema
+	//
+	// A flat binary image of a set of options that can be written once (at
+	// build time, say) and later read in place, from an embedded array or a
+	// memory-mapped file, without constructing any Option. Layout, in host byte
+	// order:
+	//
+	//   SchemaHeader
+	//   SchemaOption[optionCount]
+	//   SchemaLongName[longNameCount], sorted by name
+	//   uint32_t shortTable[256], option index per char or schemaNoOption
+	//   char strings[stringBytes]
+	//
+	// The header's hash covers everything after the header.
+	//
+	// getopt itself still builds its Options from its arguments, since they
+	// carry the variables to assign and how to convert to them, which no image
+	// can. A schema answers what needs no variables: completion (completeFrom)
+	// and checking command lines away from the program (example/batchvalidate.h).
+
+	const uint32_t schemaVersion = 2;
+	const uint32_t schemaByteOrder = 0x01020304;
+	const uint32_t schemaNoOption = 0xFFFFFFFF;
+
+	struct SchemaHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t byteOrder;
+		uint32_t optionCount;
+		uint32_t longNameCount;
+		uint32_t stringBytes;
+		uint64_t hash;
+	};
+
+	struct SchemaOption
+	{
+		uint32_t specOffset, specSize;
+		uint32_t helpOffset, helpSize;
+		uint32_t shortsOffset, shortsSize;
+		uint32_t longsOffset, longsSize; // Into the strings, '|'-separated
+		uint32_t isIncremental;
+		uint32_t type;
+		uint32_t valueSize; // As in Option
+		uint32_t valueSigned;
+	};
+
+	struct SchemaLongName
+	{
+		uint32_t offset, size;
+		uint32_t option;
+	};
+
+	inline uint64_t schemaHash(const char* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ULL; // FNV-1a
+		for(size_t i = 0; i < size; ++i)
+			hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+		return hash;
+	}
+
+	inline void writeOptionSchema(std::ostream& os, const std::vector<Option>& options)
+	{
+		std::string strings;
+		auto intern = [&](const std::string& s, uint32_t& offset, uint32_t& size)
+		{
+			offset = static_cast<uint32_t>(strings.size());
+			size = static_cast<uint32_t>(s.size());
+			strings += s;
+		};
+
+		std::vector<SchemaOption> records(options.size());
+		std::vector<SchemaLongName> longNames;
+		uint32_t shortTable[256];
+		std::fill(shortTable, shortTable + 256, schemaNoOption);
+		for(size_t i = 0; i < options.size(); ++i)
+		{
+			auto& o = options[i];
+			auto& r = records[i];
+			uint32_t index = static_cast<uint32_t>(i);
+			intern(o.spec, r.specOffset, r.specSize);
+			intern(o.help, r.helpOffset, r.helpSize);
+
+			// Sets have no stable order; sort so equal option sets serialize equally
+			std::string shorts(o.shortOpts.begin(), o.shortOpts.end());
+			std::sort(shorts.begin(), shorts.end());
+			intern(shorts, r.shortsOffset, r.shortsSize);
+			for(auto c : shorts)
+				if(shortTable[static_cast<unsigned char>(c)] == schemaNoOption)
+					shortTable[static_cast<unsigned char>(c)] = index;
+
+			std::vector<std::string> longs(o.longOpts.begin(), o.longOpts.end());
+			std::sort(longs.begin(), longs.end());
+			r.longsOffset = static_cast<uint32_t>(strings.size());
+			for(auto& l : longs)
+			{
+				SchemaLongName name;
+				intern(l, name.offset, name.size);
+				name.option = index;
+				longNames.push_back(name);
+				strings += '|';
+			}
+			r.longsSize = static_cast<uint32_t>(strings.size()) - r.longsOffset;
+			r.isIncremental = o.isIncremental;
+			r.type = static_cast<uint32_t>(o.type);
+			r.valueSize = o.valueSize;
+			r.valueSigned = o.valueSigned;
+		}
+		std::stable_sort(longNames.begin(), longNames.end(), [&](const SchemaLongName& a, const SchemaLongName& b)
+		{
+			return StringView(strings.data() + a.offset, a.size) < StringView(strings.data() + b.offset, b.size);
+		});
+
+		std::string body;
+		body.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(SchemaOption));
+		body.append(reinterpret_cast<const char*>(longNames.data()), longNames.size() * sizeof(SchemaLongName));
+		body.append(reinterpret_cast<const char*>(shortTable), sizeof(shortTable));
+		body += strings;
+
+		SchemaHeader header = {{'G', 'O', 'P', 'T'}, schemaVersion, schemaByteOrder
+			, static_cast<uint32_t>(records.size()), static_cast<uint32_t>(longNames.size())
+			, static_cast<uint32_t>(strings.size()), schemaHash(body.data(), body.size())};
+		os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		os.write(body.data(), body.size());
+	}
+
+	// Writes the schema as a C++ array definition, for embedding at build time
+	inline void writeOptionSchemaSource(std::ostream& os, const std::string& name, const std::vector<Option>& options)
+	{
+		std::ostringstream image;
+		writeOptionSchema(image, options);
+		auto bytes = image.str();
+		os << "alignas(8) constexpr unsigned char " << name << "[] = {";
+		for(size_t i = 0; i < bytes.size(); ++i)
+			os << (i % 16 ? " " : "\n\t") << static_cast<unsigned>(static_cast<unsigned char>(bytes[i])) << ',';
+		os << "\n};\n";
+	}
+
+	// Read-only view of a serialized schema. Nothing is copied or allocated;
+	// the bytes must outlive the view. The constructor throws GetOptException
+	// for images that are damaged or inconsistent.
+	class OptionSchema
+	{
+		const char* data;
+		SchemaHeader header;
+		const char* optionsBase;
+		const char* longNamesBase;
+		const char* shortTableBase;
+		const char* strings;
+
+		// The image may not be aligned, so fields are read through memcpy
+		template<typename T>
+		T read(const char* p) const
+		{
+			T t;
+			std::memcpy(&t, p, sizeof(T));
+			return t;
+		}
+
+		StringView string(uint32_t offset, uint32_t size) const
+		{
+			return StringView(strings + offset, size);
+		}
+
+		bool inStrings(uint32_t offset, uint32_t size) const
+		{
+			return uint64_t(offset) + size <= header.stringBytes;
+		}
+
+		// Checks every offset and index once, so that lookups need not; a
+		// matching hash only shows that the image wasn't damaged in transit
+		void validate() const
+		{
+			for(size_t i = 0; i < header.optionCount; ++i)
+			{
+				auto r = read<SchemaOption>(optionsBase + i * sizeof(SchemaOption));
+				if(!inStrings(r.specOffset, r.specSize) || !inStrings(r.helpOffset, r.helpSize)
+					|| !inStrings(r.shortsOffset, r.shortsSize) || !inStrings(r.longsOffset, r.longsSize))
+					throw GetOptException("Option schema has a string out of bounds");
+				if(r.type > static_cast<uint32_t>(ValueType::string))
+					throw GetOptException("Option schema has an unknown value type");
+			}
+			for(size_t i = 0; i < header.longNameCount; ++i)
+			{
+				auto entry = read<SchemaLongName>(longNamesBase + i * sizeof(SchemaLongName));
+				if(!inStrings(entry.offset, entry.size))
+					throw GetOptException("Option schema has a string out of bounds");
+				if(entry.option >= header.optionCount)
+					throw GetOptException("Option schema names an option that doesn't exist");
+				if(i && longName(i) < longName(i - 1))
+					throw GetOptException("Option schema's long names are out of order");
+			}
+			for(size_t c = 0; c < 256; ++c)
+			{
+				auto index = read<uint32_t>(shortTableBase + c * sizeof(uint32_t));
+				if(index != schemaNoOption && index >= header.optionCount)
+					throw GetOptException("Option schema names an option that doesn't exist");
+			}
+		}
+
+	public:
+		enum : size_t { npos = static_cast<size_t>(-1) };
+
+		class Entry
+		{
+			friend class OptionSchema;
+			const OptionSchema* schema;
+			SchemaOption record;
+			Entry(const OptionSchema* s, const SchemaOption& r) : schema(s), record(r){}
+		public:
+			StringView spec() const { return schema->string(record.specOffset, record.specSize); }
+			StringView help() const { return schema->string(record.helpOffset, record.helpSize); }
+			StringView shortOpts() const { return schema->string(record.shortsOffset, record.shortsSize); }
+			// Long names, each followed by '|'
+			StringView longOpts() const { return schema->string(record.longsOffset, record.longsSize); }
+			bool isIncremental() const { return record.isIncremental != 0; }
+			ValueType type() const { return static_cast<ValueType>(record.type); }
+			size_t valueSize() const { return record.valueSize; }
+			bool valueSigned() const { return record.valueSigned != 0; }
+		};
+
+		OptionSchema(const void* bytes, size_t size)
+			: data(static_cast<const char*>(bytes))
+		{
+			if(size < sizeof(SchemaHeader))
+				throw GetOptException("Option schema is truncated");
+			header = read<SchemaHeader>(data);
+			if(std::memcmp(header.magic, "GOPT", 4) != 0)
+				throw GetOptException("Not an option schema");
+			if(header.version != schemaVersion || header.byteOrder != schemaByteOrder)
+				throw GetOptException("Option schema was written by an incompatible version");
+			uint64_t bodySize = uint64_t(header.optionCount) * sizeof(SchemaOption)
+				+ uint64_t(header.longNameCount) * sizeof(SchemaLongName)
+				+ 256 * sizeof(uint32_t) + header.stringBytes;
+			if(size - sizeof(SchemaHeader) != bodySize)
+				throw GetOptException("Option schema is truncated");
+			optionsBase = data + sizeof(SchemaHeader);
+			longNamesBase = optionsBase + header.optionCount * sizeof(SchemaOption);
+			shortTableBase = longNamesBase + header.longNameCount * sizeof(SchemaLongName);
+			strings = shortTableBase + 256 * sizeof(uint32_t);
+			if(schemaHash(optionsBase, static_cast<size_t>(bodySize)) != header.hash)
+				throw GetOptException("Option schema is corrupt");
+			validate();
+		}
+
+		size_t size() const { return header.optionCount; }
+		uint64_t hash() const { return header.hash; }
+		size_t longNameCount() const { return header.longNameCount; }
+
+		// The @i-th long name in sorted order
+		StringView longName(size_t i) const
+		{
+			auto entry = read<SchemaLongName>(longNamesBase + i * sizeof(SchemaLongName));
+			return string(entry.offset, entry.size);
+		}
+
+		Entry operator[](size_t i) const
+		{
+			return Entry(this, read<SchemaOption>(optionsBase + i * sizeof(SchemaOption)));
+		}
+
+		// Index of the option with short opt @c, or npos
+		size_t findShort(char c) const
+		{
+			auto index = read<uint32_t>(shortTableBase + static_cast<unsigned char>(c) * sizeof(uint32_t));
+			return index == schemaNoOption ? static_cast<size_t>(npos) : index;
+		}
+
+		// Index of the option with long opt @name, or npos
+		size_t findLong(StringView name) const
+		{
+			size_t i = lowerBound(name);
+			if(i == header.longNameCount || longName(i) != name)
+				return npos;
+			return read<SchemaLongName>(longNamesBase + i * sizeof(SchemaLongName)).option;
+		}
+
+		// Position of the first sorted long name not less than @name
+		size_t lowerBound(StringView name) const
+		{
+			size_t low = 0, high = header.longNameCount;
+			while(low < high)
+			{
+				size_t mid = low + (high - low) / 2;
+				if(longName(mid) < name)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			return low;
 		}
 	};
 
+	// Names a compiled schema of the same options as a getopt call, so that
+	// completion queries are answered from it; see "Shell completion"
+	struct CompletionSchema
+	{
+		const OptionSchema* schema;
+	};
+
+	inline CompletionSchema completeFrom(const OptionSchema& schema)
+	{
+		return CompletionSchema{&schema};
+	}
+
 	// Assignments from captured flags
 
 	template<typename T>
@@ -239,6 +837,49 @@ namespace GetOpt // The namespace for everything associated with this library.
 									+ typeid(T).name());
 	}
 
+	// Integers convert without a stream: as stream extraction would, leading
+	// whitespace and a sign are allowed, while trailing characters and values
+	// out of range are not. Unlike it, negative values don't wrap into unsigned
+	// types. Character types still go through streams, which read them as
+	// characters rather than numbers.
+	template<typename T>
+	struct IsNumericIntegral : std::integral_constant<bool, std::is_integral<T>::value
+		&& !std::is_same<T, bool>::value && !std::is_same<T, char>::value
+		&& !std::is_same<T, signed char>::value && !std::is_same<T, unsigned char>::value
+		&& !std::is_same<T, wchar_t>::value && !std::is_same<T, char16_t>::value
+		&& !std::is_same<T, char32_t>::value>
+	{
+	};
+
+	// Converts decimal @s into @out; returns false, leaving @out alone, if it doesn't convert
+	template<typename T>
+	bool parseIntegral(StringView s, T& out)
+	{
+		typedef typename std::make_unsigned<T>::type U;
+		const char* p = s.begin();
+		const char* end = s.end();
+		while(p != end && std::isspace(static_cast<unsigned char>(*p)))
+			++p;
+		bool negative = false;
+		if(p != end && (*p == '+' || *p == '-'))
+			negative = (*p++ == '-');
+		if(p == end)
+			return false;
+		U limit = U(std::numeric_limits<T>::max());
+		if(negative)
+			limit = std::is_signed<T>::value ? U(limit + 1) : U(0);
+		U value = 0;
+		for(; p != end; ++p)
+		{
+			unsigned digit = unsigned(static_cast<unsigned char>(*p)) - '0';
+			if(digit > 9 || value > limit / 10 || (value == limit / 10 && digit > limit % 10))
+				return false;
+			value = U(value * 10 + digit);
+		}
+		out = negative ? T(U(U(0) - value)) : T(value);
+		return true;
+	}
+
 	// getoptassign is used to handle conversions from string
 
 	template<typename T>
@@ -250,14 +891,21 @@ namespace GetOpt // The namespace for everything associated with this library.
 			throwConversionException<T>(s);
 	}
 
+	template<typename T>
+	typename std::enable_if<IsNumericIntegral<T>::value>::type getoptassign(T* t, const std::string& s)
+	{
+		if(!parseIntegral(StringView(s), *t))
+			throwConversionException<T*>(s);
+	}
+
 	template<>
-	void getoptassign<std::string*>(std::string* t, const std::string& s)
+	inline void getoptassign<std::string*>(std::string* t, const std::string& s)
 	{
 		*t = s;
 	}
 
 	template<>
-	void getoptassign<bool*>(bool* t, const std::string& s)
+	inline void getoptassign<bool*>(bool* t, const std::string& s)
 	{
 		auto scopy = s;
 		transform(scopy.begin(), scopy.end(), scopy.begin(), ::tolower);
@@ -266,58 +914,555 @@ namespace GetOpt // The namespace for everything associated with this library.
 		*t = (scopy == "true");
 	}
 
-	enum class FlagType
+	// Unit-suffixed values
+	//
+	// Byte sizes take SI or IEC suffixes, in any case, since getopt may fold
+	// values: "512MiB", "4k", "1.5G", "100B". The same suffixes scale plain
+	// counts, as in "--rate=10k". Integers bind to them through byteSize():
+	//
+	//   uint64_t cache = 0;
+	//   getopt(args, "cache", GetOpt::byteSize(&cache));
+	//
+	// std::chrono durations bind directly and take ns, us, ms, s, m (or min),
+	// h or d; a bare number counts in the duration's own unit:
+	//
+	//   std::chrono::milliseconds timeout(1000);
+	//   getopt(args, "timeout", &timeout); // --timeout=250ms, --timeout=1.5s
+	//
+	// Both read a value in one pass without allocating. Fractions truncate to
+	// the target's unit, as duration_cast does, and values the target can't
+	// hold are errors rather than wrapping. Neither takes negative values.
+
+	// Whether @s is @lowercase, ignoring ASCII case
+	inline bool equalsLowercase(StringView s, StringView lowercase)
 	{
-		// All non-solitary flags have content associated with them
-		NONE,
-		SHORT_SOLITARY,
-		SHORT,// Could be a bundled set of shorts
-		LONG_SOLITARY,
-		LONG,
-	};
+		if(s.size() != lowercase.size())
+			return false;
+		for(size_t i = 0; i < s.size(); ++i)
+			if(::tolower(static_cast<unsigned char>(s[i])) != lowercase[i])
+				return false;
+		return true;
+	}
 
-	// Mutates @arg to the matched opt string
-	// If content is found, replaces @optContent with it
-	FlagType flagType(std::string& arg, std::string& optContent)
+	inline uint64_t greatestCommonDivisor(uint64_t a, uint64_t b)
 	{
-		FlagType type = FlagType::NONE;
-		auto argSize = arg.size();
-		if(argSize >= 2 && arg[0] == '-')// Must be an opt
+		while(b)
 		{
-			if(arg[1] == '-')// Long opt
+			auto r = a % b;
+			a = b;
+			b = r;
+		}
+		return a;
+	}
+
+	// An unsigned decimal, whole + fraction / scale, and what follows it
+	struct DecimalPrefix
+	{
+		uint64_t whole = 0;
+		uint64_t fraction = 0;
+		uint64_t scale = 1;
+		bool overflowed = false; // The whole part doesn't fit
+		StringView suffix;
+
+		// Reads the number at the start of @s; false if there is none
+		bool read(StringView s)
+		{
+			const uint64_t max = std::numeric_limits<uint64_t>::max();
+			const char* p = s.begin();
+			const char* end = s.end();
+			bool digits = false;
+			for(; p != end && unsigned(*p - '0') <= 9; ++p, digits = true)
 			{
-				auto equalsPos = arg.find('=');
-				auto foundEquals = (equalsPos != std::string::npos);
-				auto opt = arg.substr(2, (foundEquals
-											? equalsPos - 2
-											: std::string::npos));
-				if(equalsPos != std::string::npos)
-				{
-					type = FlagType::LONG;
-					optContent = arg.substr(equalsPos + 1);
-				}
+				unsigned digit = unsigned(*p - '0');
+				if(whole > (max - digit) / 10)
+					overflowed = true;
 				else
-					type = FlagType::LONG_SOLITARY;
-				arg = std::move(opt);
+					whole = whole * 10 + digit;
 			}
-			else// Short opt
+			if(p != end && *p == '.')
+				for(++p; p != end && unsigned(*p - '0') <= 9; ++p, digits = true)
+					if(scale < 1000000000000000000ULL)// Finer digits can't change a 64-bit result
+					{
+						fraction = fraction * 10 + unsigned(*p - '0');
+						scale *= 10;
+					}
+			suffix = StringView(p, end - p);
+			return digits;
+		}
+
+		// The number times @num / @den, truncated, into @out; false if it doesn't fit
+		bool scaled(uint64_t num, uint64_t den, uint64_t& out) const
+		{
+			const uint64_t max = std::numeric_limits<uint64_t>::max();
+			if(overflowed || (num && whole > max / num))
+				return false;
+			uint64_t f = fraction, s = scale;
+			while(num && f > max / num)
 			{
-				if(argSize != 2)// "-oSTUFF" or bundled shorts
-				{
-					// Non-bundling: assume the rest as the opt input
-					//TODO Bundling branch
-					type = FlagType::SHORT;
-					optContent = arg.substr(2);
-				}
-				else// Otherwise we have ["-o", "STUFF"]
-					type = FlagType::SHORT_SOLITARY;
-				arg = std::move(arg[1]);
+				f /= 10;
+				s /= 10;
 			}
+			uint64_t total = whole * num, part = f * num / s;
+			if(total > max - part)
+				return false;
+			out = (total + part) / den;
+			return true;
 		}
-		return type;
+	};
+
+	// Multiplier of byte size suffix @s ("", "k", "KiB", "mb", "B", ...); 0 if unknown
+	inline uint64_t byteSizeMultiplier(StringView s)
+	{
+		static const char prefixes[] = "kmgtpe";
+		uint64_t multiplier = 1;
+		size_t i = 0;
+		auto c = s.empty() ? 0 : ::tolower(static_cast<unsigned char>(s[0]));
+		if(auto prefix = c ? std::strchr(prefixes, c) : nullptr)
+		{
+			bool iec = (s.size() > 1 && ::tolower(static_cast<unsigned char>(s[1])) == 'i');
+			for(auto n = prefix - prefixes + 1; n; --n)
+				multiplier *= iec ? 1024 : 1000;
+			i = iec ? 2 : 1;
+		}
+		if(i < s.size() && ::tolower(static_cast<unsigned char>(s[i])) == 'b')
+			++i;
+		return i == s.size() ? multiplier : 0;
 	}
 
-	// SolitaryOptHandle is used to handle types where an opt by itself makes sense.
+	// Nanoseconds in the unit of duration suffix @s; 0 if unknown
+	inline uint64_t durationUnitNanoseconds(StringView s)
+	{
+		static const struct { const char* suffix; uint64_t nanoseconds; } units[] = {
+			{"ns", 1ULL}, {"us", 1000ULL}, {"\xc2\xb5s", 1000ULL}, {"ms", 1000000ULL}
+			, {"s", 1000000000ULL}, {"m", 60000000000ULL}, {"min", 60000000000ULL}
+			, {"h", 3600000000000ULL}, {"d", 86400000000000ULL}};
+		for(auto& unit : units)
+			if(equalsLowercase(s, unit.suffix))
+				return unit.nanoseconds;
+		return 0;
+	}
+
+	template<typename T>
+	struct ByteSizeTarget
+	{
+		T* target;
+	};
+
+	template<typename T>
+	ByteSizeTarget<T> byteSize(T* target)
+	{
+		static_assert(IsNumericIntegral<T>::value, "Byte sizes bind to integers");
+		return ByteSizeTarget<T>{target};
+	}
+
+	template<typename T>
+	void getoptassign(ByteSizeTarget<T> t, const std::string& s)
+	{
+		DecimalPrefix number;
+		if(!number.read(s))
+			throw GetOptException("\"" + s + "\" is not a size");
+		auto multiplier = byteSizeMultiplier(number.suffix);
+		if(!multiplier)
+			throw GetOptException("\"" + s + "\" has an unknown size suffix; expected k, M, G, T, P or E, optionally followed by i, then B");
+		uint64_t value;
+		if(!number.scaled(multiplier, 1, value) || value > uint64_t(std::numeric_limits<T>::max()))
+			throw GetOptException("\"" + s + "\" is too large");
+		*t.target = static_cast<T>(value);
+	}
+
+	template<typename Rep, typename Period>
+	void assignDuration(std::chrono::duration<Rep, Period>* t, const std::string& s
+						, const DecimalPrefix& number, uint64_t num, uint64_t den, std::false_type)
+	{
+		uint64_t value;
+		if(!number.scaled(num, den, value) || value > uint64_t(std::numeric_limits<Rep>::max()))
+			throw GetOptException("\"" + s + "\" is too long");
+		*t = std::chrono::duration<Rep, Period>(static_cast<Rep>(value));
+	}
+
+	template<typename Rep, typename Period>
+	void assignDuration(std::chrono::duration<Rep, Period>* t, const std::string& s
+						, const DecimalPrefix& number, uint64_t num, uint64_t den, std::true_type)
+	{
+		long double value = number.whole + static_cast<long double>(number.fraction) / number.scale;
+		*t = std::chrono::duration<Rep, Period>(static_cast<Rep>(value * num / den));
+	}
+
+	template<typename Rep, typename Period>
+	void getoptassign(std::chrono::duration<Rep, Period>* t, const std::string& s)
+	{
+		DecimalPrefix number;
+		if(!number.read(s))
+			throw GetOptException("\"" + s + "\" is not a duration");
+		// A value in the given unit is num / den of the target's unit
+		uint64_t num = 1, den = 1;
+		if(!number.suffix.empty())
+		{
+			num = durationUnitNanoseconds(number.suffix);
+			if(!num)
+				throw GetOptException("\"" + s + "\" has an unknown duration unit; expected ns, us, ms, s, m, h or d");
+			den = static_cast<uint64_t>(Period::num) * 1000000000ULL;
+			auto divisor = greatestCommonDivisor(num, den);
+			num /= divisor;
+			den /= divisor;
+			divisor = greatestCommonDivisor(static_cast<uint64_t>(Period::den), den);
+			den /= divisor;
+			auto periodDen = static_cast<uint64_t>(Period::den) / divisor;
+			if(num > std::numeric_limits<uint64_t>::max() / periodDen)
+				throw GetOptException("\"" + s + "\" is too long");
+			num *= periodDen;
+		}
+		assignDuration(t, s, number, num, den, std::is_floating_point<Rep>());
+	}
+
+	// Enumerated options
+	//
+	// An option can be bound to an enum (or any value type) through a table of
+	// names, e.g.
+	//
+	//   static const GetOpt::ChoiceTable<Mode> modes = {
+	//       {"fast", Mode::fast}, {"safe", Mode::safe}, {"debug", Mode::debug}};
+	//   getopt(args, "mode|m", "Run mode", GetOpt::choice(&mode, modes));
+	//
+	// The names are compiled into a perfect hash when the table is built, so
+	// converting a value is a single probe. Names are matched ignoring ASCII
+	// case, since getopt lowercases some values and not others.
+
+	template<typename E>
+	class ChoiceTable
+	{
+	public:
+		struct Choice
+		{
+			const char* name;
+			E value;
+		};
+
+		ChoiceTable(std::initializer_list<Choice> cs)
+			: choices(cs)
+		{
+			if(choices.empty())
+				throw std::logic_error("A choice table needs at least one choice");
+			for(size_t i = 0; i < choices.size(); ++i)
+			{
+				if(i)
+					names += '|';
+				names += choices[i].name;
+			}
+			// Search for a seed that sends every name to its own slot, growing
+			// the table if none is found quickly
+			for(size_t size = 2; ; size *= 2)
+			{
+				if(size < 2 * choices.size())
+					continue;
+				for(seed = 0; seed < 64; ++seed)
+					if(tryBuild(size))
+						return;
+				if(size > 64 * choices.size())
+					throw std::logic_error("Choice table has duplicate names (ignoring case): " + names);
+			}
+		}
+
+		// The choice named @name, or null
+		const Choice* find(StringView name) const
+		{
+			auto index = slots[slot(name, seed, slots.size())];
+			if(index == 0)
+				return nullptr;
+			auto& c = choices[index - 1];
+			StringView candidate(c.name);
+			if(candidate.size() != name.size())
+				return nullptr;
+			for(size_t i = 0; i < name.size(); ++i)
+				if(::tolower(static_cast<unsigned char>(candidate[i])) != ::tolower(static_cast<unsigned char>(name[i])))
+					return nullptr;
+			return &c;
+		}
+
+		// The names in the order given, '|'-separated
+		const std::string& describe() const { return names; }
+
+	private:
+		std::vector<Choice> choices;
+		std::vector<uint32_t> slots; // Index into choices plus one; zero is empty
+		uint64_t seed = 0;
+		std::string names;
+
+		static size_t slot(StringView name, uint64_t seed, size_t size)
+		{
+			uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL); // Seeded FNV-1a
+			for(auto c : name)
+				hash = (hash ^ static_cast<unsigned char>(::tolower(static_cast<unsigned char>(c)))) * 1099511628211ULL;
+			return static_cast<size_t>(hash ^ (hash >> 32)) & (size - 1);
+		}
+
+		bool tryBuild(size_t size)
+		{
+			slots.assign(size, 0);
+			for(size_t i = 0; i < choices.size(); ++i)
+			{
+				auto& s = slots[slot(choices[i].name, seed, size)];
+				if(s)
+					return false;
+				s = static_cast<uint32_t>(i + 1);
+			}
+			return true;
+		}
+	};
+
+	template<typename E>
+	struct ChoiceTarget
+	{
+		E* target;
+		const ChoiceTable<E>* table;
+	};
+
+	// Binds an option to @target through the names in @table, which must
+	// outlive the getopt call
+	template<typename E>
+	ChoiceTarget<E> choice(E* target, const ChoiceTable<E>& table)
+	{
+		return ChoiceTarget<E>{target, &table};
+	}
+
+	template<typename E>
+	void getoptassign(ChoiceTarget<E> t, const std::string& s)
+	{
+		auto c = t.table->find(s);
+		if(!c)
+			throw GetOptException("\"" + s + "\" is not one of " + t.table->describe());
+		*t.target = c->value;
+	}
+
+	// Sink options
+	//
+	// An option can be bound to a callable instead of a variable, which then
+	// receives each value as it is matched, along with the index of the
+	// option in args as originally given:
+	//
+	//   getopt(args, "define|D", GetOpt::sink([&](GetOpt::StringView value, size_t position)
+	//   {
+	//       defines.insert(value);
+	//   }));
+	//
+	// The callable is held by value, so a lambda costs no allocation and its
+	// call can be inlined. The view is only valid during the call.
+
+	template<typename F>
+	struct SinkTarget
+	{
+		F f;
+	};
+
+	template<typename F>
+	SinkTarget<F> sink(F f)
+	{
+		return SinkTarget<F>{std::move(f)};
+	}
+
+	// Hands a captured value to the target an option is bound to
+	template<typename T>
+	void assignOption(T& t, const std::string& s, size_t position)
+	{
+		getoptassign(t, s);
+	}
+
+	template<typename F>
+	void assignOption(SinkTarget<F>& t, const std::string& s, size_t position)
+	{
+		t.f(StringView(s), position);
+	}
+
+	// Positional arguments
+	//
+	// The args left after options can be bound in the same call, in order:
+	//
+	//   std::string input;
+	//   std::vector<uint64_t> ids;
+	//   getopt(argc, argv, "verbose|v", &verbose
+	//       , GetOpt::positional("input", &input), GetOpt::positionals("ids", &ids));
+	//
+	// Once options are matched, each positional() takes the next arg after the
+	// program name, which must be there, and a final positionals() takes all
+	// the rest, tail included, into its vector, which grows only once. Bound
+	// args are removed from the remaining args. Values convert as for options,
+	// and integers and strings straight from the args, without copies.
+
+	template<typename T>
+	struct PositionalTarget
+	{
+		const char* name;
+		T* target;
+	};
+
+	template<typename T>
+	struct PositionalsTarget
+	{
+		const char* name;
+		std::vector<T>* target;
+	};
+
+	template<typename T>
+	PositionalTarget<T> positional(const char* name, T* target)
+	{
+		return PositionalTarget<T>{name, target};
+	}
+
+	template<typename T>
+	PositionalsTarget<T> positionals(const char* name, std::vector<T>* target)
+	{
+		return PositionalsTarget<T>{name, target};
+	}
+
+	template<typename T>
+	typename std::enable_if<!IsNumericIntegral<T>::value>::type assignPositional(T& t, StringView arg)
+	{
+		getoptassign(&t, arg.str());
+	}
+
+	inline void assignPositional(std::string& t, StringView arg)
+	{
+		t.assign(arg.data(), arg.size());
+	}
+
+	template<typename T>
+	typename std::enable_if<IsNumericIntegral<T>::value>::type assignPositional(T& t, StringView arg)
+	{
+		if(!parseIntegral(arg, t))
+			throwConversionException<T*>(arg.str());
+	}
+
+	// Valid values of an option bound to @t, for help; empty for free-form values
+	template<typename T>
+	std::string describeChoices(const T& t)
+	{
+		return "";
+	}
+
+	template<typename E>
+	std::string describeChoices(const ChoiceTarget<E>& t)
+	{
+		return t.table->describe();
+	}
+
+	// Canonical form of a value just assigned through @t, for fingerprints:
+	// what the target now holds where that can be read back, so "-n 08" and
+	// "--num=8" agree; otherwise @content as given
+	template<typename T>
+	std::string fingerprintValue(const T& t, const std::string& content)
+	{
+		return content;
+	}
+
+	template<typename T>
+	typename std::enable_if<std::is_arithmetic<T>::value, std::string>::type
+		fingerprintValue(T* const& t, const std::string& content)
+	{
+		if(std::is_same<T, bool>::value)
+			return *t ? "true" : "false";
+		if(std::is_integral<T>::value)
+			return std::is_signed<T>::value ? std::to_string(static_cast<long long>(*t))
+				: std::to_string(static_cast<unsigned long long>(*t));
+		char exact[64];
+		std::snprintf(exact, sizeof(exact), "%La", static_cast<long double>(*t));
+		return exact;
+	}
+
+	template<typename E>
+	typename std::enable_if<std::is_enum<E>::value || std::is_integral<E>::value, std::string>::type
+		fingerprintValue(const ChoiceTarget<E>& t, const std::string& content)
+	{
+		return std::to_string(static_cast<long long>(*t.target));
+	}
+
+	// Choices of other types fingerprint by the name that matched, as the table spells it
+	template<typename E>
+	typename std::enable_if<!std::is_enum<E>::value && !std::is_integral<E>::value, std::string>::type
+		fingerprintValue(const ChoiceTarget<E>& t, const std::string& content)
+	{
+		auto choice = t.table->find(content);
+		return choice ? choice->name : content;
+	}
+
+	template<typename T>
+	std::string fingerprintValue(const ByteSizeTarget<T>& t, const std::string& content)
+	{
+		return fingerprintValue(t.target, content);
+	}
+
+	template<typename Rep, typename Period>
+	std::string fingerprintValue(std::chrono::duration<Rep, Period>* const& t, const std::string& content)
+	{
+		Rep count = t->count();
+		Rep* counted = &count;
+		return fingerprintValue(counted, content);
+	}
+
+	// Whether every value given to an option bound to @t matters, rather than the last
+	template<typename T>
+	bool accumulatesValues(const T& t)
+	{
+		return false;
+	}
+
+	template<typename F>
+	bool accumulatesValues(const SinkTarget<F>& t)
+	{
+		return true;
+	}
+
+	enum class FlagType
+	{
+		// All non-solitary flags have content associated with them
+		NONE,
+		SHORT_SOLITARY,
+		SHORT,// Could be a bundled set of shorts
+		LONG_SOLITARY,
+		LONG,
+	};
+
+	// Mutates @arg to the matched opt string
+	// If content is found, replaces @optContent with it
+	inline FlagType flagType(std::string& arg, std::string& optContent)
+	{
+		FlagType type = FlagType::NONE;
+		auto argSize = arg.size();
+		if(argSize >= 2 && arg[0] == '-')// Must be an opt
+		{
+			if(arg[1] == '-')// Long opt
+			{
+				auto equalsPos = arg.find('=');
+				auto foundEquals = (equalsPos != std::string::npos);
+				auto opt = arg.substr(2, (foundEquals
+											? equalsPos - 2
+											: std::string::npos));
+				if(equalsPos != std::string::npos)
+				{
+					type = FlagType::LONG;
+					optContent = arg.substr(equalsPos + 1);
+				}
+				else
+					type = FlagType::LONG_SOLITARY;
+				arg = std::move(opt);
+			}
+			else// Short opt
+			{
+				if(argSize != 2)// "-oSTUFF" or bundled shorts
+				{
+					// Non-bundling: assume the rest as the opt input
+					//TODO Bundling branch
+					type = FlagType::SHORT;
+					optContent = arg.substr(2);
+				}
+				else// Otherwise we have ["-o", "STUFF"]
+					type = FlagType::SHORT_SOLITARY;
+				arg = std::move(arg[1]);
+			}
+		}
+		return type;
+	}
+
+	// SolitaryOptHandle is used to handle types where an opt by itself makes sense.
 	// This is either bool or an incremental ('+' at end) opt (which should be an int).
 
 	template<class T, class Enable = void>
@@ -331,7 +1476,7 @@ namespace GetOpt // The namespace for everything associated with this library.
 	};
 	 
 	template<class T>
-	class SolitaryOptHandle<T, typename std::enable_if<std::is_integral<T>::value >::type>
+	class SolitaryOptHandle<T, typename std::enable_if<std::is_integral<typename std::remove_pointer<T>::type>::value >::type>
 	{
 	public:
 		static bool handle(T t, bool isIncremental)
@@ -342,205 +1487,1343 @@ namespace GetOpt // The namespace for everything associated with this library.
 		}
 	};
 
-	template<>
-	class SolitaryOptHandle<bool*, typename std::enable_if<true>::type>
-	{
-	public:
-		static bool handle(bool* t, bool isIncremental)
+	template<>
+	class SolitaryOptHandle<bool*, typename std::enable_if<true>::type>
+	{
+	public:
+		static bool handle(bool* t, bool isIncremental)
+		{
+			*t = true;
+			return true;
+		}
+	};
+
+	// Command line splitting
+
+	// The words of a command line. Words that needed no unescaping view the
+	// input line, which must outlive them; the rest view unescaped copies
+	// owned here.
+	class CommandLine
+	{
+	public:
+		std::vector<StringView> words;
+		std::deque<std::string> unescaped; // Never reallocates, so views stay valid
+		size_t unescapedCount = 0; // Strings in use; the rest are kept for reuse
+
+		size_t size() const { return words.size(); }
+		StringView operator[](size_t i) const { return words[i]; }
+		std::vector<StringView>::const_iterator begin() const { return words.begin(); }
+		std::vector<StringView>::const_iterator end() const { return words.end(); }
+
+		// Keeps all storage for the next split
+		void clear()
+		{
+			words.clear();
+			unescapedCount = 0;
+		}
+
+		std::string& newUnescaped(const char* begin, const char* end)
+		{
+			if(unescapedCount == unescaped.size())
+				unescaped.emplace_back();
+			return unescaped[unescapedCount++].assign(begin, end);
+		}
+	};
+
+	inline bool isShellSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\n';
+	}
+
+	// First char in [p, end) that is one of the N - 1 chars of @chars (a string
+	// literal), or end. Checks 16 bytes at a time where SSE2 is available.
+	template<size_t N>
+	const char* findAny(const char* p, const char* end, const char (&chars)[N])
+	{
+#ifdef GETOPT_SSE2
+		for(; end - p >= 16; p += 16)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			__m128i hits = _mm_setzero_si128();
+			for(size_t i = 0; i + 1 < N; ++i)
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(chars[i])));
+			if(int mask = _mm_movemask_epi8(hits))
+				return p + __builtin_ctz(static_cast<unsigned>(mask));
+		}
+#endif
+		for(; p < end; ++p)
+			for(size_t i = 0; i + 1 < N; ++i)
+				if(*p == chars[i])
+					return p;
+		return end;
+	}
+
+	// Splits @line into @out (reusing its storage) by POSIX shell rules:
+	// words are separated by blanks and newlines; single quotes preserve
+	// everything; double quotes preserve everything except \\, \", \$, \`
+	// and backslash-newline; outside quotes a backslash escapes any char.
+	// No expansions are performed.
+	inline void splitCommandLine(StringView line, CommandLine& out)
+	{
+		out.clear();
+		const char* p = line.begin();
+		const char* end = line.end();
+		auto unterminated = [&](const char* what)
+		{
+			throw GetOptException(std::string("Unterminated ") + what + " in command line at offset "
+								+ std::to_string(p - line.begin()));
+		};
+		while(true)
+		{
+			while(p < end && isShellSpace(*p))
+				++p;
+			if(p == end)
+				return;
+
+			// Fast paths: words that can view the input as-is
+			const char* special = findAny(p, end, " \t\n'\"\\");
+			if(special == end || isShellSpace(*special))
+			{
+				out.words.push_back(StringView(p, special - p));
+				p = special;
+				continue;
+			}
+			if(special == p && *p != '\\')// A word wholly in one pair of quotes
+			{
+				const char* close = (*p == '\'')
+					? findAny(p + 1, end, "'")
+					: findAny(p + 1, end, "\"\\");
+				if(close < end && *close == *p && (close + 1 == end || isShellSpace(close[1])))
+				{
+					out.words.push_back(StringView(p + 1, close - p - 1));
+					p = close + 1;
+					continue;
+				}
+			}
+
+			// Slow path: unescape into owned storage
+			std::string& word = out.newUnescaped(p, special);
+			p = special;
+			while(p < end && !isShellSpace(*p))
+			{
+				if(*p == '\\')
+				{
+					if(p + 1 == end)
+						unterminated("escape");
+					if(p[1] != '\n')// Backslash-newline continues the line
+						word += p[1];
+					p += 2;
+				}
+				else if(*p == '\'')
+				{
+					const char* close = findAny(p + 1, end, "'");
+					if(close == end)
+						unterminated("single quote");
+					word.append(p + 1, close);
+					p = close + 1;
+				}
+				else if(*p == '"')
+				{
+					const char* start = p++;
+					while(true)
+					{
+						const char* stop = findAny(p, end, "\"\\");
+						word.append(p, stop);
+						p = stop;
+						if(p == end)
+						{
+							p = start;
+							unterminated("double quote");
+						}
+						if(*p == '"')
+							break;
+						if(p + 1 == end)
+						{
+							p = start;
+							unterminated("double quote");
+						}
+						char escaped = p[1];
+						if(escaped == '"' || escaped == '\\' || escaped == '$' || escaped == '`')
+							word += escaped;
+						else if(escaped != '\n')
+							word.append(p, 2);
+						p += 2;
+					}
+					++p;
+				}
+				else
+				{
+					const char* stop = findAny(p, end, " \t\n'\"\\");
+					word.append(p, stop);
+					p = stop;
+				}
+			}
+			out.words.push_back(StringView(word));
+		}
+	}
+
+	inline CommandLine splitCommandLine(StringView line)
+	{
+		CommandLine commandLine;
+		splitCommandLine(line, commandLine);
+		return commandLine;
+	}
+
+	// UTF-8 validation
+	//
+	// With config::validateUtf8, a session checks every arg as it begins, in
+	// one pass and before anything else reads them, and throws for the first
+	// arg that isn't valid UTF-8, naming its index and the offset of the bad
+	// byte. With config::replaceInvalidUtf8 instead, each maximal invalid
+	// subpart of an arg is replaced by U+FFFD, as the Unicode standard
+	// recommends; only args that need it are copied. Either applies from the
+	// first stage of a session on. Overlong forms, surrogates and code points
+	// past U+10FFFF are invalid.
+
+	// Length of the valid UTF-8 sequence at @p, or 0 if there is none; then
+	// @invalid is the length of its maximal invalid subpart
+	inline size_t utf8SequenceLength(const unsigned char* p, const unsigned char* end, size_t& invalid)
+	{
+		unsigned char c = *p;
+		if(c < 0x80)
+			return 1;
+		size_t length = 0;
+		unsigned char low = 0x80, high = 0xBF; // Bounds of the second byte
+		if(c >= 0xC2 && c <= 0xDF)
+			length = 2;
+		else if(c >= 0xE0 && c <= 0xEF)
+		{
+			length = 3;
+			if(c == 0xE0)
+				low = 0xA0;
+			else if(c == 0xED)
+				high = 0x9F;
+		}
+		else if(c >= 0xF0 && c <= 0xF4)
+		{
+			length = 4;
+			if(c == 0xF0)
+				low = 0x90;
+			else if(c == 0xF4)
+				high = 0x8F;
+		}
+		invalid = 1;
+		if(!length)
+			return 0;
+		for(size_t i = 1; i < length; ++i, low = 0x80, high = 0xBF)
+		{
+			if(p + i == end || p[i] < low || p[i] > high)
+				return 0;
+			invalid = i + 1;
+		}
+		return length;
+	}
+
+	// Offset of the first invalid UTF-8 sequence in @s, or s.size() if there
+	// is none. Runs of ASCII are skipped 16 bytes at a time where SSE2 is
+	// available.
+	inline size_t findInvalidUtf8(StringView s)
+	{
+		auto begin = reinterpret_cast<const unsigned char*>(s.data());
+		auto p = begin;
+		auto end = p + s.size();
+		while(p < end)
+		{
+#ifdef GETOPT_SSE2
+			for(; end - p >= 16; p += 16)
+				if(int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))))
+				{
+					p += __builtin_ctz(static_cast<unsigned>(mask));
+					break;
+				}
+			if(p == end)
+				break;
+#endif
+			size_t invalid;
+			size_t length = utf8SequenceLength(p, end, invalid);
+			if(!length)
+				return p - begin;
+			p += length;
+		}
+		return s.size();
+	}
+
+	// @s with each maximal invalid subpart from offset @from on replaced by U+FFFD
+	inline std::string replaceInvalidUtf8(StringView s, size_t from)
+	{
+		std::string repaired(s.data(), from);
+		auto p = reinterpret_cast<const unsigned char*>(s.data()) + from;
+		auto end = reinterpret_cast<const unsigned char*>(s.end());
+		while(p < end)
+		{
+			size_t invalid;
+			if(size_t length = utf8SequenceLength(p, end, invalid))
+			{
+				repaired.append(reinterpret_cast<const char*>(p), length);
+				p += length;
+			}
+			else
+			{
+				repaired += "\xEF\xBF\xBD";
+				p += invalid;
+			}
+		}
+		return repaired;
+	}
+
+	using ArgVector = std::vector<std::string>;
+
+#ifdef GETOPT_TRACE
+#ifndef GETOPT_TRACE_SIZE
+#define GETOPT_TRACE_SIZE 128
+#endif
+
+	// Parse trace
+	//
+	// With GETOPT_TRACE defined, each thread records every parse decision into
+	// a fixed ring of its last GETOPT_TRACE_SIZE events, without allocating:
+	// which token matched which option, the value each option consumed, and
+	// whether converting it succeeded. dumpParseTrace() prints the ring, which
+	// is most useful when catching a GetOptException; a command line holding
+	// traceFlag also dumps it to std::cerr once its parse session ends.
+	// Without GETOPT_TRACE, the tracing macros expand to nothing.
+	//
+	// GETOPT_TRACE adds members to ParseSession and changes the bodies of
+	// inline functions, so it, and GETOPT_TRACE_SIZE, must be defined the same
+	// way in every translation unit of a program, as from the compiler's
+	// command line. Mixing traced and untraced units violates the one
+	// definition rule, and the linker keeps whichever definitions it likes.
+
+	enum class TraceKind : uint8_t
+	{
+		begin, // A parse session started; token is its token count
+		matched, // token matched option
+		value, // option consumed text, from token, as its value
+		stopped, // stopOnFirstNonOption stopped at token
+		missingValue,
+		unrecognized,
+		finished, // token is how many args are left
+	};
+
+	struct TraceEvent
+	{
+		TraceKind kind;
+		FlagType type;
+		bool pending; // A value that hasn't converted (yet); after the parse, it failed to
+		uint32_t token;
+		char text[32]; // Truncated and NUL-terminated, as is spec
+		char spec[24];
+	};
+
+	class ParseTrace
+	{
+	public:
+		void record(TraceKind kind, size_t token, FlagType type, StringView text, StringView spec)
+		{
+			auto& e = events[next++ % GETOPT_TRACE_SIZE];
+			e.kind = kind;
+			e.type = type;
+			e.pending = (kind == TraceKind::value);
+			e.token = static_cast<uint32_t>(token);
+			copy(e.text, text);
+			copy(e.spec, spec);
+		}
+
+		// Marks the latest event's value as converted
+		void converted()
+		{
+			if(next)
+				events[(next - 1) % GETOPT_TRACE_SIZE].pending = false;
+		}
+
+		size_t size() const { return next < GETOPT_TRACE_SIZE ? next : GETOPT_TRACE_SIZE; }
+		// Oldest first
+		const TraceEvent& operator[](size_t i) const { return events[(next - size() + i) % GETOPT_TRACE_SIZE]; }
+		void clear() { next = 0; }
+
+	private:
+		std::array<TraceEvent, GETOPT_TRACE_SIZE> events;
+		size_t next = 0;
+
+		template<size_t N>
+		static void copy(char (&out)[N], StringView s)
+		{
+			auto n = s.size() < N - 1 ? s.size() : N - 1;
+			if(n)
+				std::memcpy(out, s.data(), n);
+			out[n] = '\0';
+		}
+	};
+
+	inline ParseTrace& parseTrace()
+	{
+		static thread_local ParseTrace trace;
+		return trace;
+	}
+
+	const char* const traceFlag = "--__getopt-trace";
+
+	inline void dumpParseTrace(std::ostream& os)
+	{
+		static const char* const kinds[] = {"begin", "matched", "value", "stopped", "missing value", "unrecognized", "finished"};
+		static const char* const types[] = {"", "short", "short", "long", "long"};
+		auto& trace = parseTrace();
+		os << "getopt trace, oldest first:" << std::endl;
+		for(size_t i = 0; i < trace.size(); ++i)
+		{
+			auto& e = trace[i];
+			os << "  [" << e.token << "] " << kinds[static_cast<int>(e.kind)];
+			switch(e.kind)
+			{
+				case TraceKind::begin:
+					os << ", " << e.token << " args";
+					break;
+				case TraceKind::finished:
+					os << ", " << e.token << " args left";
+					break;
+				case TraceKind::value:
+					os << " \"" << e.text << "\" for " << e.spec << (e.pending ? ": conversion FAILED" : ": converted");
+					break;
+				default:
+					os << ' ' << types[static_cast<int>(e.type)] << " \"" << e.text << '"';
+					if(e.spec[0])
+						os << " for " << e.spec;
+					break;
+			}
+			os << std::endl;
+		}
+	}
+
+	#define GETOPT_TRACE_EVENT(...) ::GetOpt::parseTrace().record(__VA_ARGS__)
+	#define GETOPT_TRACE_CONVERTED() ::GetOpt::parseTrace().converted()
+#else
+	#define GETOPT_TRACE_EVENT(...)
+	#define GETOPT_TRACE_CONVERTED()
+#endif
+
+	// Parse sessions
+	//
+	// A parse session classifies every arg once, into a token stream. Each
+	// stage (the option specs of one getopt call) then matches its options
+	// against that stream, marking the tokens it takes as consumed. The check
+	// for unrecognized options, the builtin help and the removal of consumed
+	// args all happen once, in finish(). getopt(...) is a session with a
+	// single stage; modular programs can give each module its own stage:
+	//
+	//   GetOpt::ParseSession session(args);
+	//   auto netResult = session.parse("port|p", &port);
+	//   auto logResult = session.parse("verbose|v+", &verbosity);
+	//   auto result = session.finish(); // Throws on unrecognized options
+	//
+	// Stages need no config::passThrough. Unrecognized options are only let
+	// through if the last stage ends with config::passThrough in effect.
+	// Since no stage knows the options of the stages after it, help is only
+	// answered before anything else when given as --help; a bare -h is
+	// matched like any other option.
+
+	// A zero-copy range over args as they were given: argv, the strings of an
+	// ArgVector, or the words of a CommandLine, which must outlive it.
+	//
+	// Parsing stops at the "--" terminator, or with config::stopOnFirstNonOption
+	// at the first non-option after the program name; the args from there on
+	// are the tail, which is never looked at. By default the tail is copied
+	// into the remaining args like everything else. With config::keepTailInPlace,
+	// getopt(argc, argv) and getopt(CommandLine) instead leave it out and expose
+	// it as GetOptResultAndArgs::tail, so that `tool -v -- <millions of paths>`
+	// costs what `tool -v` does. (An ArgVector keeps its tail either way.)
+	class ArgRange
+	{
+	public:
+		ArgRange() = default;
+		ArgRange(const char* const* argv, size_t first, size_t last)
+			: argv(argv), first(first), last(last)
+		{}
+		ArgRange(const std::string* strings, size_t first, size_t last)
+			: strings(strings), first(first), last(last)
+		{}
+		ArgRange(const StringView* words, size_t first, size_t last)
+			: words(words), first(first), last(last)
+		{}
+
+		size_t size() const { return last - first; }
+		bool empty() const { return first == last; }
+		StringView operator[](size_t i) const
+		{
+			i += first;
+			return argv ? StringView(argv[i]) : strings ? StringView(strings[i]) : words[i];
+		}
+		// Whether arg @i is the terminator "--"; argv args aren't measured for it
+		bool isTerminator(size_t i) const
+		{
+			i += first;
+			return argv ? std::strcmp(argv[i], "--") == 0 : strings ? strings[i] == "--" : words[i] == "--";
+		}
+		// At most the first @n bytes of arg @i, reading no further into argv args
+		StringView prefix(size_t i, size_t n) const
+		{
+			if(!argv)
+			{
+				auto arg = (*this)[i];
+				return StringView(arg.data(), std::min(arg.size(), n));
+			}
+			auto arg = argv[i + first];
+			size_t size = 0;
+			while(size < n && arg[size])
+				++size;
+			return StringView(arg, size);
+		}
+		// The args from @begin on, relative to this range
+		ArgRange from(size_t begin) const
+		{
+			ArgRange r = *this;
+			r.first = (begin < size()) ? first + begin : last;
+			return r;
+		}
+
+		class const_iterator
+		{
+		public:
+			const_iterator(const ArgRange* range, size_t i) : range(range), i(i) {}
+			StringView operator*() const { return (*range)[i]; }
+			const_iterator& operator++() { ++i; return *this; }
+			bool operator==(const const_iterator& it) const { return i == it.i; }
+			bool operator!=(const const_iterator& it) const { return i != it.i; }
+		private:
+			const ArgRange* range;
+			size_t i;
+		};
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, size()); }
+
+	private:
+		const char* const* argv = nullptr;
+		const std::string* strings = nullptr;
+		const StringView* words = nullptr;
+		size_t first = 0, last = 0;
+	};
+
+	// One arg of a parse session, classified once
+	struct Token
+	{
+		StringView raw;
+		std::string folded; // Lowercased raw; empty when raw has no uppercase
+		FlagType type = FlagType::NONE;
+		size_t nameBegin = 0, nameSize = 0;
+		size_t contentBegin = 0; // Content runs to the end of the arg
+		bool consumed = false;
+
+		explicit Token(StringView arg)
+			: raw(arg)
+		{
+			auto size = arg.size();
+			if(size >= 2 && arg[0] == '-')// Must be an opt
+			{
+				if(arg[1] == '-')// Long opt
+				{
+					auto equals = std::find(arg.begin() + 2, arg.end(), '=');
+					nameBegin = 2;
+					nameSize = equals - arg.begin() - 2;
+					type = (equals == arg.end()) ? FlagType::LONG_SOLITARY : FlagType::LONG;
+					contentBegin = (equals == arg.end()) ? size : nameBegin + nameSize + 1;
+				}
+				else// Short opt; "-oSTUFF" or bundled shorts carry content
+				{
+					nameBegin = 1;
+					nameSize = 1;
+					type = (size == 2) ? FlagType::SHORT_SOLITARY : FlagType::SHORT;
+					contentBegin = 2;
+				}
+			}
+			if(type == FlagType::NONE)// Never read through name() or content()
+				return;
+			for(auto c : arg)
+				if(::tolower(static_cast<unsigned char>(c)) != c)
+				{
+					folded.assign(arg.begin(), arg.end());
+					std::transform(folded.begin(), folded.end(), folded.begin(), ::tolower);
+					break;
+				}
+		}
+
+		StringView text(bool caseSensitive) const
+		{
+			return (caseSensitive || folded.empty()) ? raw : StringView(folded);
+		}
+		StringView name(bool caseSensitive) const
+		{
+			return StringView(text(caseSensitive).data() + nameBegin, nameSize);
+		}
+		std::string content(bool caseSensitive) const
+		{
+			auto t = text(caseSensitive);
+			return std::string(t.data() + contentBegin, t.size() - contentBegin);
+		}
+	};
+
+	class ParseSession
+	{
+	public:
+		// Args are classified lazily, as matching reaches them, so nothing past
+		// where parsing stops is ever looked at.
+
+		// Parses @args; finish() removes what was consumed from them
+		explicit ParseSession(ArgVector& args)
+			: args(&args), source(args.data(), 0, args.size())
+		{
+			tokens.reserve(args.size()); // Already paid for by the strings themselves
+			begin();
+		}
+
+		// Parses @argv in place; remainingArgs() holds what is left after finish()
+		ParseSession(int argc, char** argv)
+			: source(argv, 0, argc)
+		{
+			begin();
+		}
+
+		// Parses the words of @commandLine in place, which must outlive the session
+		explicit ParseSession(const CommandLine& commandLine)
+			: source(commandLine.words.data(), 0, commandLine.size())
+		{
+			begin();
+		}
+
+		ParseSession(const ParseSession&) = delete;
+		ParseSession& operator=(const ParseSession&) = delete;
+
+#ifdef GETOPT_TRACE
+		~ParseSession()
+		{
+			if(dumpTrace)
+				dumpParseTrace(std::cerr);
+		}
+#endif
+
+		// Runs one stage: matches the given option specs against the tokens
+		// not yet consumed
+		template<typename...Args>
+		GetOptResult parse(Args&&...getoptargs)
+		{
+			return parseStage(false, getoptargs...);
+		}
+
+		// As parse(), for a session with no other stage, as getopt(...) is
+		template<typename...Args>
+		GetOptResult parseSoleStage(Args&&...getoptargs)
+		{
+			return parseStage(true, getoptargs...);
+		}
+
+		// Begins a stage configured by @stage: for the first stage, checks the
+		// args as UTF-8 if asked to; then finds where a stop on the first
+		// non-option falls and, for the first stage, whether help comes first.
+		// Once a stage has asked to stop, every later stage finds the stop
+		// again, as its options may take the earlier stop as a value; the stop
+		// only ever moves later, past args earlier stages have scanned.
+		// @options() gives the stage's options, built only when a decision
+		// needs them; @sole says no other stage follows.
+		template<typename Options>
+		void beginStage(const GetOptConfiguration& stage, Options options, bool sole)
+		{
+			if(!stagesBegun)
+				checkUtf8(stage);
+			size_t stop = stopAt;
+			if(stage.stopOnFirstNonOption && !stopping)
+			{
+				stopping = true;
+				stop = findStop(stage, options(), sole);
+			}
+			else if(stopAt != GetOptResult::npos)
+				stop = std::max(stopAt, findStop(stage, options(), sole));
+			if(stop != stopAt && stop != GetOptResult::npos)
+			{
+				GETOPT_TRACE_EVENT(TraceKind::stopped, stop, tokens[stop].type, tokens[stop].raw, StringView());
+			}
+			stopAt = stop;
+			if(stagesBegun)
+				return;
+			stagesBegun = true;
+			auto help = findHelpArg(stage);
+			if(help == GetOptResult::npos)
+				return;
+			if(argAt(help).size() > 2)// --help
+				helpFirst = true;
+			else if(sole)// -h is help unless another option owns it
+			{
+				auto& probe = options();
+				auto id = probe.optionId('h');
+				helpFirst = (id != GetOptResult::npos && probe.options[id].longOpts.count("help") > 0);
+			}
+		}
+
+		// Ends the session, adding the builtin help to @result
+		void finish(GetOptResult& result);
+		GetOptResult finish()
+		{
+			GetOptResult result;
+			finish(result);
+			return result;
+		}
+
+		// What is left after finish(); for a session over an ArgVector, that vector
+		ArgVector& remainingArgs()
+		{
+			return args ? *args : remaining;
+		}
+
+		// The tail left in place after finish(), with config::keepTailInPlace
+		ArgRange tail() const
+		{
+			return tailInPlace;
+		}
+
+		// Matches option @id of @result against the unconsumed tokens,
+		// assigning to @t; returns whether it was found
+		template<typename T>
+		bool match(GetOptConfiguration& config, GetOptResult& result, size_t id, T& t)
+		{
+			if(config.collectOnly)
+				return false;
+			const Option& option = result.options[id];
+			if(helpFirst && !option.longOpts.count("help"))
+				return false;
+			bool found = false;
+			for(size_t i = 0; i < stopAt && reach(i); ++i)
+			{
+				Token& token = tokens[i];
+				if(token.consumed)
+					continue;
+				bool matched = false;
+				switch(token.type)
+				{
+					case FlagType::NONE:
+						continue;
+					case FlagType::LONG:
+					case FlagType::LONG_SOLITARY:
+					{
+						auto name = token.name(config.caseSensitive);
+						for(auto& longOpt : option.longOpts)
+							if(name == StringView(longOpt))
+							{
+								matched = true;
+								break;
+							}
+						break;
+					}
+					case FlagType::SHORT:
+					case FlagType::SHORT_SOLITARY:
+						matched = (option.shortOpts.count(token.name(config.caseSensitive)[0]) > 0);
+						break;
+				}
+				if(!matched)
+					continue;
+
+				found = true;
+				token.consumed = true;
+				result.recordUse(id, i);
+				GETOPT_TRACE_EVENT(TraceKind::matched, i, token.type, token.raw, StringView(option.spec));
+				std::string content;
+#ifdef GETOPT_TRACE
+				size_t from = i; // Where the value came from
+#endif
+				if(token.type == FlagType::LONG_SOLITARY || token.type == FlagType::SHORT_SOLITARY)
+				{
+					if(SolitaryOptHandle<T>::handle(t, option.isIncremental))
+					{
+						result.fingerprintUse(id, fingerprintValue(t, std::string()), false);
+						continue;
+					}
+					// The content is the next arg nothing has taken yet
+					size_t next = i + 1;
+					while(next < stopAt && reach(next) && tokens[next].consumed)
+						++next;
+					if(next >= stopAt || !reach(next))
+					{
+						GETOPT_TRACE_EVENT(TraceKind::missingValue, i, token.type, token.raw, StringView(option.spec));
+						throw GetOptException("Expected input after option " + token.name(config.caseSensitive).str());
+					}
+					tokens[next].consumed = true;
+					content = tokens[next].raw.str();
+#ifdef GETOPT_TRACE
+					from = next;
+#endif
+				}
+				else
+					content = token.content(config.caseSensitive);
+				GETOPT_TRACE_EVENT(TraceKind::value, from, token.type, StringView(content), StringView(option.spec));
+				try
+				{
+					assignOption(t, content, i);
+				}
+				catch(GetOptException& e)
+				{
+					throw GetOptException("Option " + token.name(config.caseSensitive).str() + ": " + e.what());
+				}
+				GETOPT_TRACE_CONVERTED();
+				result.fingerprintUse(id, fingerprintValue(t, content), accumulatesValues(t));
+				result.usages[id].lastValue = std::move(content);
+			}
+			return found;
+		}
+
+		// Positionals are bound in finish(), in the order they were added
+		template<typename T>
+		void addPositional(const PositionalTarget<T>& p)
+		{
+			addPositional(Positional{p.name, p.target, &assignOne<T>, nullptr});
+		}
+
+		template<typename T>
+		void addPositional(const PositionalsTarget<T>& p)
+		{
+			addPositional(Positional{p.name, p.target, &appendOne<T>, &reserveMore<T>});
+		}
+
+		// Whether help was asked for, so that only help options are matched
+		// and nothing is validated; decided as the first stage begins
+		bool answeringHelp() const
+		{
+			return helpFirst;
+		}
+
+		// Called as each stage ends
+		void endStage(const GetOptConfiguration& config, const GetOptResult& result)
+		{
+			lastConfig = config;
+			if(result.definedOption("help") || result.definedOption('h'))
+				helpDefined = true;
+		}
+
+	private:
+		template<typename...Args>
+		GetOptResult parseStage(bool sole, Args&&...getoptargs);
+
+		ArgVector* args = nullptr;
+		ArgRange source;
+		ArgVector remaining;
+		ArgRange tailInPlace;
+		std::vector<Token> tokens; // Args classified so far, up to any terminator
+		size_t stopAt = GetOptResult::npos; // Where a stage stopped on a non-option
+		bool stopping = false; // Some stage stops on the first non-option
+		bool hasTerminator = false; // At index tokens.size()
+		bool helpDefined = false;
+		bool stagesBegun = false;
+		bool helpFirst = false;
+		std::deque<std::pair<size_t, std::string>> repairs; // Args replaced for invalid UTF-8, by index
+		std::vector<StringView> measured; // Args of argv as validated, repairs applied; empty otherwise
+		GetOptConfiguration lastConfig;
+#ifdef GETOPT_TRACE
+		bool dumpTrace = false; // traceFlag was given
+#endif
+
+		struct Positional
+		{
+			const char* name;
+			void* target;
+			void (*assign)(void* target, StringView arg);
+			void (*reserve)(void* target, size_t count); // Only for positionals()
+		};
+		std::vector<Positional> positionalTargets;
+
+		template<typename T>
+		static void assignOne(void* target, StringView arg)
+		{
+			assignPositional(*static_cast<T*>(target), arg);
+		}
+
+		template<typename T>
+		static void appendOne(void* target, StringView arg)
+		{
+			T value{};
+			assignPositional(value, arg);
+			static_cast<std::vector<T>*>(target)->push_back(std::move(value));
+		}
+
+		template<typename T>
+		static void reserveMore(void* target, size_t count)
+		{
+			auto& values = *static_cast<std::vector<T>*>(target);
+			values.reserve(values.size() + count);
+		}
+
+		void addPositional(const Positional& p)
+		{
+			if(!positionalTargets.empty() && positionalTargets.back().reserve)
+				throw std::logic_error(std::string("Positional ") + p.name + " follows positionals(), which takes the rest");
+			positionalTargets.push_back(p);
+		}
+
+		// Whether @arg is @flag, ignoring ASCII case unless @caseSensitive
+		static bool spells(StringView arg, StringView flag, bool caseSensitive)
+		{
+			return caseSensitive ? arg == flag : equalsLowercase(arg, flag);
+		}
+
+		// Index of the first arg spelling the builtin help before where
+		// parsing ends, or npos. Looks at args as given, without classifying or
+		// copying them.
+		size_t findHelpArg(const GetOptConfiguration& config) const
+		{
+			for(size_t i = 1; i < source.size() && i < stopAt; ++i)
+			{
+				// One byte past "--help" tells it from longer args
+				auto arg = (repairs.empty() && measured.empty()) ? source.prefix(i, 7) : argAt(i);
+				if(arg == "--")
+					break;
+				if(spells(arg, "--help", config.caseSensitive) || spells(arg, "-h", config.caseSensitive))
+					return i;
+			}
+			return GetOptResult::npos;
+		}
+
+		// Where parsing stops with config::stopOnFirstNonOption, or npos: at
+		// the first unconsumed non-option after the program name that isn't
+		// the value of an option among @options given alone before it. Unless
+		// @sole, a non-option right after an option the stage doesn't know may
+		// be that option's value in a later stage, so it doesn't stop. Every
+		// option of the stage then scans up to the same point.
+		size_t findStop(const GetOptConfiguration& config, const GetOptResult& options, bool sole)
+		{
+			for(size_t i = 1; reach(i); ++i)
+			{
+				Token& token = tokens[i];
+				if(token.consumed)
+					continue;
+				if(token.type == FlagType::NONE)
+					return i;
+				if(token.type != FlagType::LONG_SOLITARY && token.type != FlagType::SHORT_SOLITARY)
+					continue;
+				auto name = token.name(config.caseSensitive);
+				size_t id = GetOptResult::npos;
+				if(token.type == FlagType::SHORT_SOLITARY)
+					id = options.optionId(name[0]);
+				else if(name.size() > 1)// Single characters are only ever short opts
+					id = options.optionId(name.str());
+				// Its value is the next arg nothing has taken yet, as in match()
+				size_t value = i + 1;
+				while(reach(value) && tokens[value].consumed)
+					++value;
+				if(id == GetOptResult::npos)
+				{
+					if(!sole && reach(value) && tokens[value].type == FlagType::NONE)
+						i = value;
+				}
+				else if(options.options[id].takesValue())
+					i = value;
+			}
+			return GetOptResult::npos;
+		}
+
+		// Arg @i, as repaired if it was invalid UTF-8
+		StringView argAt(size_t i) const
+		{
+			if(i < measured.size())
+				return measured[i];
+			if(!repairs.empty())
+			{
+				auto repair = std::lower_bound(repairs.begin(), repairs.end(), i
+					, [](const std::pair<size_t, std::string>& r, size_t index) { return r.first < index; });
+				if(repair != repairs.end() && repair->first == i)
+					return StringView(repair->second);
+			}
+			return source[i];
+		}
+
+		// Checks every arg as UTF-8 if @config asks to; see "UTF-8 validation"
+		void checkUtf8(const GetOptConfiguration& config)
+		{
+			if(!config.validateUtf8 && !config.replaceInvalidUtf8)
+				return;
+			if(!args)// Only argv args need measuring; keep their lengths for argAt
+				measured.reserve(source.size());
+			for(size_t i = 0; i < source.size(); ++i)
+			{
+				auto arg = source[i];
+				if(!args)
+					measured.push_back(arg);
+				auto offset = findInvalidUtf8(arg);
+				if(offset == arg.size())
+					continue;
+				if(!config.replaceInvalidUtf8)
+					throw GetOptException("Arg " + std::to_string(i) + " is not valid UTF-8 at byte " + std::to_string(offset));
+				if(args)
+					(*args)[i] = replaceInvalidUtf8(arg, offset);
+				else
+				{
+					repairs.emplace_back(i, replaceInvalidUtf8(arg, offset));
+					measured.back() = StringView(repairs.back().second);
+				}
+			}
+		}
+
+		bool isPositional(size_t i) const
+		{
+			return !tokens[i].consumed && tokens[i].type == FlagType::NONE;
+		}
+
+		// Assigns @arg to @p, naming the positional in any error as match()
+		// names the option
+		static void assignTo(const Positional& p, StringView arg)
+		{
+			try
+			{
+				p.assign(p.target, arg);
+			}
+			catch(GetOptException& e)
+			{
+				throw GetOptException(std::string("Positional ") + p.name + ": " + e.what());
+			}
+		}
+
+		// Binds positionals to the unconsumed non-options after the program
+		// name, then to the tail from @tailBegin on; returns where the unbound
+		// part of the tail begins
+		size_t bindPositionals(size_t prefixEnd, size_t tailBegin)
+		{
+			size_t i = 1;
+			for(auto& p : positionalTargets)
+			{
+				if(p.reserve)
+				{
+					size_t count = source.size() - tailBegin;
+					for(size_t j = i; j < prefixEnd; ++j)
+						count += isPositional(j);
+					p.reserve(p.target, count);
+					for(; i < prefixEnd; ++i)
+						if(isPositional(i))
+						{
+							assignTo(p, tokens[i].raw);
+							tokens[i].consumed = true;
+						}
+					for(; tailBegin < source.size(); ++tailBegin)
+						assignTo(p, argAt(tailBegin));
+					break;
+				}
+				while(i < prefixEnd && !isPositional(i))
+					++i;
+				if(i < prefixEnd)
+				{
+					assignTo(p, tokens[i].raw);
+					tokens[i++].consumed = true;
+				}
+				else if(tailBegin < source.size())
+					assignTo(p, argAt(tailBegin++));
+				else
+					throw GetOptException(std::string("Expected positional argument ") + p.name);
+			}
+			return tailBegin;
+		}
+
+		void begin()
+		{
+			GETOPT_TRACE_EVENT(TraceKind::begin, source.size(), FlagType::NONE, StringView(), StringView());
+		}
+
+		// Classifies args up to index @i unless the terminator comes first;
+		// returns whether token @i exists
+		bool reach(size_t i)
 		{
-			*t = true;
+			while(tokens.size() <= i)
+			{
+				if(hasTerminator || tokens.size() == source.size())
+					return false;
+				if(source.isTerminator(tokens.size()))
+				{
+					hasTerminator = true;
+					return false;
+				}
+				auto arg = argAt(tokens.size());
+				tokens.emplace_back(arg);
+#ifdef GETOPT_TRACE
+				if(arg == traceFlag)
+				{
+					tokens.back().consumed = true;
+					dumpTrace = true;
+				}
+#endif
+			}
 			return true;
 		}
 	};
 
-	using ArgVector = std::vector<std::string>;
-
-	// TODO: Move semantics for option?
 	// TODO: Could we include these all under the same struct template?
 
 	template<typename T, typename...Ts>
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	void bindOption(ParseSession& session
+						, GetOptConfiguration& config, GetOptResult& result
+						, size_t id, T t, Ts&&...ts);
+
+	template<typename T, typename...Ts>
+	void getopthelper(ParseSession& session
 						, GetOptConfiguration& config, GetOptResult& result
 						, const std::string& optSpec, T t, Ts&&...ts)
 	{
-		getopthelper(args, argsLimit, config, result, Option(optSpec), t, ts...);
+		bindOption(session, config, result, result.emplaceOption(optSpec), t, ts...);
 	}
 
 	template<typename T, typename...Ts>
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	void getopthelper(ParseSession& session
 						, GetOptConfiguration& config, GetOptResult& result
 						, const char* optSpec, T t, Ts&&...ts)
 	{
-		getopthelper(args, argsLimit, config, result, std::string(optSpec), t, ts...);
+		getopthelper(session, config, result, std::string(optSpec), t, ts...);
 	}
 
 	template<typename T, typename...Ts>
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	void getopthelper(ParseSession& session
 						, GetOptConfiguration& config, GetOptResult& result
 						, const std::string& optSpec, const std::string& help, T t, Ts&&...ts)
 	{
-		getopthelper(args, argsLimit, config, result, Option(optSpec, help), t, ts...);
+		bindOption(session, config, result, result.emplaceOption(optSpec, help), t, ts...);
 	}
 
 	template<typename T, typename...Ts>
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	void getopthelper(ParseSession& session
 						, GetOptConfiguration& config, GetOptResult& result
 						, const char* optSpec, const std::string& help, T t, Ts&&...ts)
 	{
-		getopthelper(args, argsLimit, config, result, std::string(optSpec), help, t, ts...);
+		getopthelper(session, config, result, std::string(optSpec), help, t, ts...);
 	}
 
 	template<typename T, typename...Ts>
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	void getopthelper(ParseSession& session
 						, GetOptConfiguration& config, GetOptResult& result
 						, const std::string& optSpec, const char* help, T t, Ts&&...ts)
 	{
-		getopthelper(args, argsLimit, config, result, optSpec, std::string(help), t, ts...);
+		getopthelper(session, config, result, optSpec, std::string(help), t, ts...);
 	}
 
 	template<typename T, typename...Ts>
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	void getopthelper(ParseSession& session
 						, GetOptConfiguration& config, GetOptResult& result
 						, const char* optSpec, const char* help, T t, Ts&&...ts)
 	{
-		getopthelper(args, argsLimit, config, result, std::string(optSpec), std::string(help), t, ts...);
+		getopthelper(session, config, result, std::string(optSpec), std::string(help), t, ts...);
 	}
 
 	template<typename T, typename...Ts>
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	void getopthelper(ParseSession& session
 						, GetOptConfiguration& config, GetOptResult& result
-						, const Option& option, T t, Ts&&...ts)
+						, Option option, T t, Ts&&...ts)
 	{
-		// Construct the opt
-		bool foundFlag = false;
-		if(result.parsing)// XXX: Does D return a complete Option[] after stopping?
-		{
-			std::string optContent;
-			for(size_t argsIndex = 0; argsIndex < argsLimit;)// Flag find loop
-			{
-				std::string arg = args[argsIndex];
-				if(!config.caseSensitive)
-					std::transform(arg.begin(), arg.end(), arg.begin(), ::tolower);
+		bindOption(session, config, result, result.addOption(std::move(option)), t, ts...);
+	}
 
-				bool foundHere = false;
-				bool expectingContentNext = false;
-				auto type = flagType(arg, optContent);
-				switch(type)// Remember: arg and optContent are mutated!
-				{
-					case FlagType::NONE:
-						if(config.stopOnFirstNonOption)
-						{
-							result.parsing = false;
-							goto END_PARSE;
-						}
-						break;
-					case FlagType::SHORT_SOLITARY:
-					case FlagType::LONG_SOLITARY:
-						expectingContentNext = true;
-					case FlagType::LONG:
-					case FlagType::SHORT:
-						switch(type) // Remember: might have fallen through
-						{
-							case FlagType::LONG:
-							case FlagType::LONG_SOLITARY:
-								foundHere = foundFlag = (option.longOpts.count(arg) > 0);
-								break;
-							case FlagType::SHORT:
-							case FlagType::SHORT_SOLITARY:
-								foundHere = foundFlag = (option.shortOpts.count(arg[0]) > 0);
-								break;
-							default:
-								throw std::logic_error("internal error: incorrect flag type after parse");
-						}
-						break;
-					default:
-						throw std::logic_error("Uncaught flag type");
-				}
-				// Handle find result and shift; we'll handle the args index shift ourselves
-				if(foundHere)
-				{
-					auto shiftArgs = [&]()
-					{
-						args.erase(args.begin() + argsIndex);
-						--argsLimit;
-					};
-					shiftArgs();
-					if(expectingContentNext)// Haven't gotten the content yet
-					{
-						expectingContentNext = false;
-						if(SolitaryOptHandle<T>::handle(t, option.isIncremental))
-							continue;
-						else
-						{
-							if(argsLimit <= argsIndex)
-								throw GetOptException("Expected input after option " + arg);
-							optContent = args[argsIndex];
-							shiftArgs();
-						}
-					}
-					getoptassign(t, optContent);
-					continue;
-				}
-				else
-					++argsIndex;// Do the shift, since we took nothing
-			}
-		}
-		END_PARSE:
-		if(!foundFlag && config.required)
-			throw GetOptException("Required option " + option.spec + " was not supplied");
-		result.options.push_back(option);
+	// Binds option @id, just added to @result, to @t and matches it
+	template<typename T, typename...Ts>
+	void bindOption(ParseSession& session
+						, GetOptConfiguration& config, GetOptResult& result
+						, size_t id, T t, Ts&&...ts)
+	{
+		describeValue<T>(result.options[id]);
+		result.options[id].choices = describeChoices(t);
+		result.options[id].excludedFromFingerprint = config.excludeFromFingerprint;
+		bool foundFlag = session.match(config, result, id, t);
+		if(!foundFlag && config.required && !config.collectOnly && !session.answeringHelp())
+			throw GetOptException("Required option " + result.options[id].spec + " was not supplied");
 		config.required = false; // required flag should only affect one arg
-		getopthelper(args, argsLimit, config, result, ts...);
+		config.excludeFromFingerprint = false;
+		getopthelper(session, config, result, ts...);
 	}
 	
 	// config value
 	template<typename...Ts>
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	void getopthelper(ParseSession& session
 						, GetOptConfiguration& configuration, GetOptResult& result
 						, config configOption, Ts&&...ts)
 	{
 		configuration.set(configOption);
-		getopthelper(args, argsLimit, configuration, result, ts...);
+		getopthelper(session, configuration, result, ts...);
 	}
 		
+	// A completion schema only matters before parsing; see getoptcomplete
+	template<typename...Ts>
+	void getopthelper(ParseSession& session
+						, GetOptConfiguration& config, GetOptResult& result
+						, CompletionSchema completion, Ts&&...ts)
+	{
+		getopthelper(session, config, result, ts...);
+	}
+
+	template<typename T, typename...Ts>
+	void getopthelper(ParseSession& session
+						, GetOptConfiguration& config, GetOptResult& result
+						, PositionalTarget<T> p, Ts&&...ts)
+	{
+		session.addPositional(p);
+		getopthelper(session, config, result, ts...);
+	}
+
+	template<typename T, typename...Ts>
+	void getopthelper(ParseSession& session
+						, GetOptConfiguration& config, GetOptResult& result
+						, PositionalsTarget<T> p, Ts&&...ts)
+	{
+		session.addPositional(p);
+		getopthelper(session, config, result, ts...);
+	}
+
 	// Finished parsing args
-	void getopthelper(ArgVector& args, size_t& argsLimit
+	inline void getopthelper(ParseSession& session
 						, GetOptConfiguration& config, GetOptResult& result)
 	{
-		// Baked-in help check
-		if(!result.definedOption("help") && !result.definedOption('h'))
-			getopthelper(args, argsLimit, config, result, "help|h", "Shows this help", &result.helpWanted);
+		session.endStage(config, result);
+	}
+
+	// The configuration set anywhere in a stage's getopt args
+	inline void stageConfig(GetOptConfiguration& configuration)
+	{
+	}
+
+	template<typename T, typename...Ts>
+	void stageConfig(GetOptConfiguration& configuration, const T& t, Ts&&...ts)
+	{
+		stageConfig(configuration, ts...);
+	}
+
+	template<typename...Ts>
+	void stageConfig(GetOptConfiguration& configuration, config configOption, Ts&&...ts)
+	{
+		configuration.set(configOption);
+		stageConfig(configuration, ts...);
+	}
+
+	template<typename...Args>
+	GetOptResult collectOptions(Args&&...getoptargs);
 
-		if(!config.passThrough) // Check for args we didn't get
+	template<typename...Args>
+	GetOptResult ParseSession::parseStage(bool sole, Args&&...getoptargs)
+	{
+		// Help first: when help is asked for, options are defined but not
+		// converted, and nothing is required or unrecognized. Finding it costs
+		// one pass over the args. A bare -h needs every option known, to see
+		// that -h isn't some other option's, so only a sole stage answers it
+		// first; sessions of several stages only answer --help first. The
+		// stage's options are built at most once, and only when a stop or a
+		// bare -h needs them.
+		GetOptConfiguration stage;
+		stageConfig(stage, getoptargs...);
+		GetOptResult probe;
+		bool probed = false;
+		beginStage(stage, [&]() -> const GetOptResult&
 		{
-			for(size_t i = 0; i < argsLimit; ++i)
+			if(!probed)
 			{
-				std::string arg = args[i], content;
-				switch(flagType(arg, content))
+				probe = collectOptions(getoptargs...);
+				probed = true;
+			}
+			return probe;
+		}, sole);
+
+		GetOptResult result;
+		GetOptConfiguration config;
+		getopthelper(*this, config, result, getoptargs...);
+		return result;
+	}
+
+	inline void ParseSession::finish(GetOptResult& result)
+	{
+		// Baked-in help, unless some stage defined its own
+		if(!helpDefined)
+		{
+			GetOptConfiguration config = lastConfig;
+			getopthelper(*this, config, result, "help|h", "Shows this help", &result.helpWanted);
+		}
+
+		// Without an early stop, everything up to the terminator is checked
+		bool stopped = (stopAt != GetOptResult::npos);
+		result.parsing = !stopped;
+		if(!stopped)
+			reach(source.size());
+		size_t prefixEnd = stopped ? stopAt : tokens.size();
+
+		if(!lastConfig.passThrough && !lastConfig.collectOnly && !helpFirst) // Check for args we didn't get
+		{
+			for(size_t i = 0; i < prefixEnd; ++i)
+				if(!tokens[i].consumed && tokens[i].type != FlagType::NONE)
 				{
-					case FlagType::NONE:
-						break;
-					default:
-						throw GetOptException("Unrecognized option " + args[i]);
+					GETOPT_TRACE_EVENT(TraceKind::unrecognized, i, tokens[i].type, tokens[i].raw, StringView());
+					throw GetOptException("Unrecognized option " + tokens[i].raw.str());
+				}
+		}
+
+		// The tail is everything from an early stop on, or else what follows
+		// the terminator
+		size_t tailBegin = prefixEnd;
+		bool keepTerminator = false;
+		if(!stopped && hasTerminator)
+		{
+			++tailBegin;
+			keepTerminator = lastConfig.keepEndOfOptions;
+		}
+		if(!lastConfig.collectOnly && !result.helpWanted && !helpFirst)
+			tailBegin = bindPositionals(prefixEnd, tailBegin);
+
+		// What is left: unconsumed args before the tail, the terminator if
+		// asked to keep it, then whatever positionals left of the tail
+		if(args)
+		{
+			size_t out = 0;
+			for(size_t i = 0; i < prefixEnd; ++i)
+				if(!tokens[i].consumed)
+				{
+					if(out != i)
+						(*args)[out] = std::move((*args)[i]);
+					++out;
 				}
+			if(keepTerminator)
+			{
+				if(out != prefixEnd)
+					(*args)[out] = std::move((*args)[prefixEnd]);
+				++out;
 			}
+			if(out != tailBegin)// Otherwise the tail is already in place
+				for(size_t i = tailBegin; i < args->size(); ++i)
+					(*args)[out++] = std::move((*args)[i]);
+			else
+				out = args->size();
+			args->resize(out);
+		}
+		else
+		{
+			remaining.clear();
+			for(size_t i = 0; i < prefixEnd; ++i)
+				if(!tokens[i].consumed)
+					remaining.push_back(tokens[i].raw.str());
+			// A tail with repaired args can't be left in place
+			bool inPlace = lastConfig.keepTailInPlace
+				&& (repairs.empty() || repairs.back().first < tailBegin);
+			if(keepTerminator && inPlace && tailBegin == prefixEnd + 1)
+				--tailBegin;// The terminator stays with the tail
+			else if(keepTerminator)
+				remaining.push_back(source[prefixEnd].str());
+			if(inPlace)
+				tailInPlace = source.from(tailBegin);
+			else
+				for(size_t i = tailBegin; i < source.size(); ++i)
+					remaining.push_back(argAt(i).str());
 		}
+		GETOPT_TRACE_EVENT(TraceKind::finished, remainingArgs().size(), FlagType::NONE, StringView(), StringView());
+		tokens.clear();
 	}
 
-	bool findTerminatorIndex(ArgVector& args, size_t& argsLimit)//XXX: Inline?
+	// Builds the option specs of a getopt call without touching any args
+	template<typename...Args>
+	GetOptResult collectOptions(Args&&...getoptargs)
 	{
-		for(size_t i = 0; i < args.size(); ++i)
-			if(args[i] == "--")
-			{
-				argsLimit = i;
-				return true;
-			}
-		return false;
+		ArgVector noArgs;
+		ParseSession session(noArgs);
+		GetOptResult result;
+		GetOptConfiguration config;
+		config.collectOnly = true;
+		getopthelper(session, config, result, getoptargs...);
+		session.finish(result);
+		return result;
 	}
 
 	// These are almost certainly the functions you want as an end user.
 
-	void defaultGetoptPrinter(std::ostream& os, const std::string& message, std::vector<Option> options)
+	inline void defaultGetoptPrinter(std::ostream& os, const std::string& message, const std::vector<Option>& options)
 	{
   		os << message << std::endl;
 		size_t longestLong = 0;
@@ -551,24 +2834,278 @@ namespace GetOpt // The namespace for everything associated with this library.
 		for(auto& o : options)
 			os << std::setw(2) << (o.shortOptForHelp.empty() ? " " : '-' + o.shortOptForHelp)
 		  	   << std::setw(longestLong + 3) << (o.longOptForHelp.empty() ? " " : "--" + o.longOptForHelp)
-		  	   << " " << o.help << std::endl;
+		  	   << " " << o.help
+		  	   << (o.choices.empty() ? "" : (o.help.empty() ? "(" : " (") + o.choices + ")") << std::endl;
 	}
 
-	void defaultGetoptPrinter(const std::string& message, std::vector<Option> options)
+	inline void defaultGetoptPrinter(const std::string& message, const std::vector<Option>& options)
 	{
 		defaultGetoptPrinter(std::cout, message, options);
 	}
 
+	// Shell completion
+	//
+	// getopt(argc, argv, ...) answers these hidden options itself before any
+	// parsing takes place, then exits:
+	//
+	//   --__complete <index> <words...>       print the option spellings that
+	//                                         complete words[index]
+	//   --__completion-script <bash|zsh|fish> print a completion script
+	//
+	// Completions are answered from the getopt call's option specs, which are
+	// built for each query. Naming a compiled schema of the same options
+	// answers them from the schema's tables instead, building nothing:
+	//
+	//   static const GetOpt::OptionSchema schema(toolSchema, sizeof(toolSchema));
+	//   getopt(argc, argv, GetOpt::completeFrom(schema), "port|p", &port, ...);
+
+	const char* const completeFlag = "--__complete";
+	const char* const completionScriptFlag = "--__completion-script";
+
+	// Every spelling of every option, sorted so that completing a prefix is a
+	// range query
+	class CompletionTable
+	{
+	public:
+		struct Entry
+		{
+			std::string word;
+			const Option* option;
+
+			bool operator<(const Entry& e) const { return word < e.word; }
+		};
+
+		std::vector<Entry> entries;
+
+		CompletionTable(const std::vector<Option>& options)
+		{
+			for(auto& o : options)
+			{
+				for(auto c : o.shortOpts)
+					entries.push_back(Entry{std::string("-") + c, &o});
+				for(auto& l : o.longOpts)
+					entries.push_back(Entry{"--" + l, &o});
+			}
+			std::sort(entries.begin(), entries.end());
+		}
+
+		// Calls @f with every entry starting with @prefix, in sorted order
+		template<typename F>
+		void complete(const std::string& prefix, F f) const
+		{
+			auto it = std::lower_bound(entries.begin(), entries.end(), Entry{prefix, nullptr});
+			for(; it != entries.end() && it->word.compare(0, prefix.size(), prefix) == 0; ++it)
+				f(*it);
+		}
+	};
+
+	// Writes the completions for words[index]; values and positionals are
+	// left to the shell's default completion
+	inline void printCompletions(std::ostream& os, const std::vector<Option>& options
+							, const ArgVector& words, size_t index)
+	{
+		std::string word = index < words.size() ? words[index] : "";
+		if(!word.empty() && word[0] != '-')
+			return;
+		if(word.find('=') != std::string::npos)
+			return;
+		CompletionTable(options).complete(word, [&](const CompletionTable::Entry& e)
+		{
+			os << e.word << '\n';
+		});
+	}
+
+	// As above, answered straight from a compiled schema
+	inline void printCompletions(std::ostream& os, const OptionSchema& schema
+							, const ArgVector& words, size_t index)
+	{
+		std::string word = index < words.size() ? words[index] : "";
+		if(!word.empty() && word[0] != '-')
+			return;
+		if(word.find('=') != std::string::npos)
+			return;
+		if(word.size() < 2 || word[1] == '-')
+		{
+			StringView prefix = word.size() > 2 ? StringView(word.data() + 2, word.size() - 2) : StringView();
+			for(auto i = schema.lowerBound(prefix); i < schema.longNameCount(); ++i)
+			{
+				auto name = schema.longName(i);
+				if(name.size() < prefix.size() || StringView(name.data(), prefix.size()) != prefix)
+					break;
+				os << "--" << name << '\n';
+			}
+		}
+		if(word.size() < 2)
+		{
+			for(int c = 0; c < 256; ++c)
+				if(schema.findShort(static_cast<char>(c)) != OptionSchema::npos)
+					os << '-' << static_cast<char>(c) << '\n';
+		}
+		else if(word.size() == 2 && word[1] != '-' && schema.findShort(word[1]) != OptionSchema::npos)
+			os << word << '\n';
+	}
+
+	inline std::string completionFunctionName(const std::string& program)
+	{
+		std::string name = "_getopt_";
+		for(auto c : program)
+			name += (std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+		return name;
+	}
+
+	// Quotes @s as a single-quoted shell word
+	inline std::string shellQuote(const std::string& s)
+	{
+		std::string quoted = "'";
+		for(auto c : s)
+		{
+			if(c == '\'')
+				quoted += "'\\''";
+			else
+				quoted += c;
+		}
+		return quoted + "'";
+	}
+
+	inline void printCompletionScript(std::ostream& os, const std::string& shell
+								, std::string program, const std::vector<Option>& options)
+	{
+		auto slash = program.find_last_of("/\\");
+		if(slash != std::string::npos)
+			program = program.substr(slash + 1);
+		auto function = completionFunctionName(program);
+		if(shell == "bash")
+		{
+			os << function << "()\n{\n"
+			   << "\tCOMPREPLY=($(\"${COMP_WORDS[0]}\" " << completeFlag
+			   << " \"$COMP_CWORD\" \"${COMP_WORDS[@]}\" 2>/dev/null))\n"
+			   << "}\n"
+			   << "complete -o default -F " << function << ' ' << program << '\n';
+		}
+		else if(shell == "zsh")
+		{
+			os << "#compdef " << program << "\n"
+			   << function << "()\n{\n"
+			   << "\t_arguments";
+			for(auto& o : options)
+			{
+				// _arguments descriptions end at ']' and treat ':' specially
+				std::string help;
+				for(auto c : o.help)
+				{
+					if(c == ']' || c == ':' || c == '\\')
+						help += '\\';
+					help += c;
+				}
+				// A value may follow in the same word ("-p80", "--port=80") or the next
+				std::string value;
+				if(o.takesValue())
+				{
+					value = ":value:";
+					if(!o.choices.empty())
+					{
+						std::string choices = o.choices;
+						std::replace(choices.begin(), choices.end(), '|', ' ');
+						value += '(' + choices + ')';
+					}
+				}
+				for(auto c : o.shortOpts)
+					os << " \\\n\t\t" << shellQuote(std::string("-") + c + (o.takesValue() ? "+" : "") + '[' + help + ']' + value);
+				for(auto& l : o.longOpts)
+					os << " \\\n\t\t" << shellQuote("--" + l + (o.takesValue() ? "=" : "") + '[' + help + ']' + value);
+			}
+			os << " \\\n\t\t'*:file:_files'\n"
+			   << "}\n"
+			   << "compdef " << function << ' ' << program << '\n';
+		}
+		else if(shell == "fish")
+		{
+			for(auto& o : options)
+			{
+				os << "complete -c " << program;
+				for(auto c : o.shortOpts)
+					os << " -s " << c;
+				for(auto& l : o.longOpts)
+					os << " -l " << shellQuote(l);
+				if(o.takesValue())
+					os << " -r";
+				if(!o.help.empty())
+					os << " -d " << shellQuote(o.help);
+				os << '\n';
+			}
+		}
+		else
+			throw GetOptException("Unknown shell for completion script: " + shell);
+	}
+
+	// Whether @argv asks for completions or a completion script
+	inline bool isCompletionRequest(int argc, char** argv)
+	{
+		return argc >= 2 && (std::strcmp(argv[1], completeFlag) == 0
+							|| std::strcmp(argv[1], completionScriptFlag) == 0);
+	}
+
+	// Answers the completion request in @argv from @options and exits
+	inline void answerCompletion(int argc, char** argv, const std::vector<Option>& options)
+	{
+		if(std::strcmp(argv[1], completeFlag) == 0)
+		{
+			if(argc >= 3)
+				printCompletions(std::cout, options
+					, ArgVector(argv + 3, argv + argc), std::strtoul(argv[2], nullptr, 10));
+		}
+		else
+			printCompletionScript(std::cout, argc >= 3 ? argv[2] : "bash", argv[0], options);
+		std::cout.flush();
+		std::exit(0);
+	}
+
+	// Answers the --__complete request in @argv from @schema and exits
+	inline void answerCompletion(int argc, char** argv, const OptionSchema& schema)
+	{
+		if(argc >= 3)
+			printCompletions(std::cout, schema
+				, ArgVector(argv + 3, argv + argc), std::strtoul(argv[2], nullptr, 10));
+		std::cout.flush();
+		std::exit(0);
+	}
+
+	// The schema named by completeFrom among @getoptargs, or null
+	inline const OptionSchema* completionSchema()
+	{
+		return nullptr;
+	}
+
+	template<typename T, typename...Ts>
+	const OptionSchema* completionSchema(const T& t, Ts&&...ts)
+	{
+		return completionSchema(ts...);
+	}
+
+	template<typename...Ts>
+	const OptionSchema* completionSchema(CompletionSchema completion, Ts&&...ts)
+	{
+		return completion.schema;
+	}
+
+	// Answers the completion request in @argv and exits without parsing
+	// anything. Completion scripts, generated once per install, always come
+	// from the option specs.
+	template<typename...Args>
+	void getoptcomplete(int argc, char** argv, Args&&...getoptargs)
+	{
+		auto schema = completionSchema(getoptargs...);
+		if(schema && std::strcmp(argv[1], completeFlag) == 0)
+			answerCompletion(argc, argv, *schema);
+		answerCompletion(argc, argv, collectOptions(getoptargs...).options);
+	}
+
 	template<typename...Args>
 	GetOptResult getopt(ArgVector& args, Args&&...getoptargs)
 	{
-		GetOptResult result;
-		GetOptConfiguration config;
-		auto argsLimit = args.size();
-		bool hasTerminator = findTerminatorIndex(args, argsLimit); // Remember: argsLimit is mutated
-		getopthelper(args, argsLimit, config, result, getoptargs...);
-		if(hasTerminator && !config.keepEndOfOptions)
-			args.erase(args.begin() + argsLimit);
+		ParseSession session(args);
+		auto result = session.parseSoleStage(getoptargs...);
+		session.finish(result);
 		return result;
 	}
 
@@ -578,21 +3115,181 @@ namespace GetOpt // The namespace for everything associated with this library.
 	{
 		GetOptResult result;
 		ArgVector args;
+		ArgRange tail; // With config::keepTailInPlace, the args after args
 
 		GetOptResultAndArgs() = default;
-		GetOptResultAndArgs(GetOptResult r, ArgVector as)
-			: result(r), args(as)
+		GetOptResultAndArgs(GetOptResult r, ArgVector as, ArgRange t = ArgRange())
+			: result(std::move(r)), args(std::move(as)), tail(t)
 		{}
 	};
 
 	template<typename...Args>
 	GetOptResultAndArgs getopt(int argc, char** argv, Args&&...getoptargs)
 	{
-		ArgVector args(argc);
-		for(size_t i = 0; i < argc; ++i)
-			args[i] = argv[i];
-		auto result = getopt(args, getoptargs...);
-		return GetOptResultAndArgs(result, std::move(args));
+		if(isCompletionRequest(argc, argv))
+			getoptcomplete(argc, argv, getoptargs...);
+		ParseSession session(argc, argv);
+		auto result = session.parseSoleStage(getoptargs...);
+		session.finish(result);
+		return GetOptResultAndArgs(std::move(result), std::move(session.remainingArgs()), session.tail());
+	}
+
+	// Parses a command line from splitCommandLine; its first word is the
+	// program name, as with argv
+	template<typename...Args>
+	GetOptResultAndArgs getopt(const CommandLine& commandLine, Args&&...getoptargs)
+	{
+		ParseSession session(commandLine);
+		auto result = session.parseSoleStage(getoptargs...);
+		session.finish(result);
+		return GetOptResultAndArgs(std::move(result), std::move(session.remainingArgs()), session.tail());
+	}
+
+	// Static option registry
+	//
+	// Options can be declared at namespace scope in any translation unit, next
+	// to the code that uses them:
+	//
+	//   static int port = 8080;
+	//   GETOPT_OPTION(port, "port|p", "Port to listen on", &port);
+	//
+	// and parsed for the whole process by one call from main:
+	//
+	//   auto results = GetOpt::getoptRegistered(argc, argv);
+	//
+	// Each declaration is a static node linked into an intrusive list whose
+	// head is a function-local static, so declarations never depend on another
+	// translation unit having been initialized and nothing is allocated for
+	// them. The list is compiled into a GetOptResult's lookup tables the first
+	// time it is needed, so don't parse or query it before main.
+
+	class RegisteredOption
+	{
+	public:
+		RegisteredOption(const RegisteredOption&) = delete;
+		RegisteredOption& operator=(const RegisteredOption&) = delete;
+
+		const char* spec() const { return optSpec; }
+		const char* help() const { return optHelp; }
+		RegisteredOption* following() const { return next; }
+
+		// The first option registered, in initialization order
+		static RegisteredOption* first() { return list().first; }
+		static size_t count() { return list().count; }
+
+		// Fills in what @option can only learn from the target's type
+		void describe(Option& option) const { describer(*this, option); }
+
+		// Matches this option, as option @id of @result, against @session
+		bool match(ParseSession& session, GetOptConfiguration& config, GetOptResult& result, size_t id)
+		{
+			return matcher(*this, session, config, result, id);
+		}
+
+	protected:
+		using Describer = void (*)(const RegisteredOption&, Option&);
+		using Matcher = bool (*)(RegisteredOption&, ParseSession&, GetOptConfiguration&, GetOptResult&, size_t);
+
+		RegisteredOption(const char* spec, const char* help, Describer describer, Matcher matcher)
+			: optSpec(spec), optHelp(help), describer(describer), matcher(matcher)
+		{
+			auto& l = list();
+			*l.tail = this;
+			l.tail = &next;
+			++l.count;
+		}
+
+	private:
+		struct List
+		{
+			RegisteredOption* first = nullptr;
+			RegisteredOption** tail = &first;
+			size_t count = 0;
+		};
+
+		const char* optSpec;
+		const char* optHelp;
+		Describer describer;
+		Matcher matcher;
+		RegisteredOption* next = nullptr;
+
+		static List& list()
+		{
+			static List l;
+			return l;
+		}
+	};
+
+	// A registered option bound to @target, any value getopt itself accepts
+	template<typename T>
+	class StaticOption : public RegisteredOption
+	{
+	public:
+		StaticOption(const char* spec, const char* help, T target)
+			: RegisteredOption(spec, help, &describeTarget, &matchTarget), target(target)
+		{}
+
+	private:
+		T target;
+
+		static void describeTarget(const RegisteredOption& self, Option& option)
+		{
+			describeValue<T>(option);
+			option.choices = describeChoices(static_cast<const StaticOption&>(self).target);
+		}
+
+		static bool matchTarget(RegisteredOption& self, ParseSession& session
+								, GetOptConfiguration& config, GetOptResult& result, size_t id)
+		{
+			return session.match(config, result, id, static_cast<StaticOption&>(self).target);
+		}
+	};
+
+	// Declares a registered option; @name only needs to be unique in its file
+	#define GETOPT_OPTION(name, spec, help, target) \
+		static ::GetOpt::StaticOption<decltype(target)> getoptRegisteredOption_##name(spec, help, target)
+
+	// Every registered option, plus the builtin help unless one of them took
+	// help or h, compiled on first use
+	inline const GetOptResult& registeredOptions()
+	{
+		static const GetOptResult compiled = []()
+		{
+			GetOptResult result;
+			for(auto node = RegisteredOption::first(); node; node = node->following())
+				node->describe(result.options[result.emplaceOption(node->spec(), node->help())]);
+			if(!result.definedOption("help") && !result.definedOption('h'))
+				result.options[result.emplaceOption("help|h", "Shows this help")].type = ValueType::boolean;
+			return result;
+		}();
+		return compiled;
+	}
+
+	// Parses every registered option from @argv in one pass, with @configs in
+	// effect for all of them
+	inline GetOptResultAndArgs getoptRegistered(int argc, char** argv, std::initializer_list<config> configs = {})
+	{
+		auto& compiled = registeredOptions();
+		if(isCompletionRequest(argc, argv))
+			answerCompletion(argc, argv, compiled.options);
+
+		GetOptConfiguration configuration;
+		for(auto c : configs)
+			configuration.set(c);
+		ParseSession session(argc, argv);
+		session.beginStage(configuration, [&]() -> const GetOptResult& { return compiled; }, true);
+		GetOptResult result = compiled;
+		size_t id = 0;
+		for(auto node = RegisteredOption::first(); node; node = node->following(), ++id)
+			node->match(session, configuration, result, id);
+		if(id < result.options.size())// The builtin help
+		{
+			bool* helpWanted = &result.helpWanted;
+			session.match(configuration, result, id, helpWanted);
+		}
+		session.endStage(configuration, result);
+		session.finish(result);
+		return GetOptResultAndArgs(std::move(result), std::move(session.remainingArgs()), session.tail());
 	}
 };
 
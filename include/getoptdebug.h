@@ -11,8 +11,8 @@
 #include <iostream>
 namespace GetOpt
 {
-	void printGetOptHelper(std::ostream& os){}
-	void printGetOptHelper(std::ostream& os, const GetOpt::config& c)
+	inline void printGetOptHelper(std::ostream& os){}
+	inline void printGetOptHelper(std::ostream& os, const GetOpt::config& c)
 	{
 		os << '<';
 		switch(c)
@@ -44,6 +44,18 @@ namespace GetOpt
 			case GetOpt::config::stopOnFirstNonOption:
 				os << "stopOnFirstNonOption";
 				break;					
+			case GetOpt::config::excludeFromFingerprint:
+				os << "excludeFromFingerprint";
+				break;
+			case GetOpt::config::keepTailInPlace:
+				os << "keepTailInPlace";
+				break;
+			case GetOpt::config::validateUtf8:
+				os << "validateUtf8";
+				break;
+			case GetOpt::config::replaceInvalidUtf8:
+				os << "replaceInvalidUtf8";
+				break;
 			default:
 				os << "UNKNOWN_CONFIG_OPT";
 				break;
@@ -51,6 +63,24 @@ namespace GetOpt
 		os << ">; ";
 	}
 
+	template<typename E>
+	std::ostream& operator<<(std::ostream& os, const ChoiceTarget<E>& c)
+	{
+		return os << c.target << " <choice of " << c.table->describe() << '>';
+	}
+
+	template<typename T>
+	std::ostream& operator<<(std::ostream& os, const ByteSizeTarget<T>& b)
+	{
+		return os << b.target << " <byte size>";
+	}
+
+	template<typename F>
+	std::ostream& operator<<(std::ostream& os, const SinkTarget<F>& s)
+	{
+		return os << "<sink>";
+	}
+
 	template<typename T, typename...Args>
 	void printGetOptHelper(std::ostream& os, const std::string& s, const T& t, Args&&...args)
 	{
@@ -64,6 +94,27 @@ namespace GetOpt
 		printGetOptHelper(os, std::string(c), t, args...);
 	}
 
+	template<typename T, typename...Args>
+	void printGetOptHelper(std::ostream& os, const PositionalTarget<T>& p, Args&&...args)
+	{
+		os << "<positional " << p.name << ">: " << p.target << "; ";
+		printGetOptHelper(os, args...);
+	}
+
+	template<typename T, typename...Args>
+	void printGetOptHelper(std::ostream& os, const PositionalsTarget<T>& p, Args&&...args)
+	{
+		os << "<positionals " << p.name << ">: " << p.target << "; ";
+		printGetOptHelper(os, args...);
+	}
+
+	template<typename...Args>
+	void printGetOptHelper(std::ostream& os, const CompletionSchema& c, Args&&...args)
+	{
+		os << "<completion schema of " << c.schema->size() << " options>; ";
+		printGetOptHelper(os, args...);
+	}
+
 	template<typename...Args>
 	void printGetOptHelper(std::ostream& os, const GetOpt::config& c, Args&&...args)
 	{
@@ -88,7 +139,7 @@ namespace GetOpt
 	}
 
 	//REMOVE: Debug functions
-	void variadicAddresses(){}
+	inline void variadicAddresses(){}
 	template<typename...Ts>
 	void variadicAddresses(GetOpt::config& c, Ts&&...ts)
 	{
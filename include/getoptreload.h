@@ -0,0 +1,349 @@
+/**
+ * getoptreload.h
+ * Live-reloadable options: an options file parsed into immutable snapshots,
+ * which reader threads pick up with one atomic load.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#ifndef GETOPTRELOAD_H
+#define GETOPTRELOAD_H
+
+#include "getopt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#define GETOPT_INOTIFY
+#endif
+
+namespace GetOpt
+{
+	// Reloadable options
+	//
+	// Values live in snapshots of a struct of your own, never in variables that
+	// threads read directly. A binder applies the usual getopt definitions to
+	// the fields of a fresh snapshot:
+	//
+	//   struct ServerOptions { int port = 80; std::string root = "."; };
+	//   GetOpt::ReloadableOptions<ServerOptions> options("server.conf"
+	//       , [](ServerOptions& o, GetOpt::ArgVector& args)
+	//       {
+	//           return GetOpt::getopt(args, "port|p", &o.port, "root", &o.root);
+	//       });
+	//
+	//   auto& reader = options.reader(); // Once per reader thread
+	//   auto snapshot = reader.read(); // Each request
+	//   serve(snapshot->values.port);
+	//   reader.quiesce(); // Between requests
+	//   reader.close(); // When the thread is done
+	//
+	//   if(options.poll()) // The service loop
+	//       for(auto id : options.current()->changed) ...
+	//
+	// The file holds options as they would appear on a command line. Newlines
+	// separate words like spaces do, and quoting works as in splitCommandLine.
+	// A file that fails to parse leaves the current snapshot in place, and
+	// poll() throws the error.
+	//
+	// Reclamation is quiescent-state based: read() is a single acquire load,
+	// and every snapshot a reader has read stays valid until that reader next
+	// calls quiesce(), which records the generation it has caught up with. A
+	// replaced snapshot is freed once every open reader has caught up past it:
+	// at the next reload, or sooner through reclaim(). A reader that stops
+	// quiescing holds back reclamation, so one going idle calls release() and
+	// quiesces again before its next read. close() gives a reader's slot back
+	// for reader() to hand out again.
+
+	template<typename T>
+	struct OptionSnapshot
+	{
+		T values;
+		GetOptResult result; // Option usage as of this snapshot
+		std::vector<size_t> changed; // Ids of options used differently than in the previous snapshot
+		uint64_t generation = 0;
+	};
+
+	// Ids of options whose usage differs between @before and @after, results of
+	// the same option definitions. Values compare as converted, through their
+	// fingerprint contributions, so "08080" after "8080" is no change; options
+	// excluded from fingerprints compare as given. An option missing from
+	// @before counts as unused.
+	inline std::vector<size_t> changedOptions(const GetOptResult& before, const GetOptResult& after)
+	{
+		static const GetOptResult::OptionUsage unused{};
+		std::vector<size_t> changed;
+		for(size_t id = 0; id < after.usages.size(); ++id)
+		{
+			auto& b = (id < before.usages.size()) ? before.usages[id] : unused;
+			auto& a = after.usages[id];
+			bool differs = after.options[id].excludedFromFingerprint
+				? a.lastValue != b.lastValue : a.contribution != b.contribution;
+			if(a.count != b.count || differs)
+				changed.push_back(id);
+		}
+		return changed;
+	}
+
+	template<typename T>
+	class ReloadableOptions
+	{
+	public:
+		using Snapshot = OptionSnapshot<T>;
+		using Binder = std::function<GetOptResult(T&, ArgVector&)>;
+
+		// One thread's view of the snapshots
+		class Reader
+		{
+			friend class ReloadableOptions;
+			ReloadableOptions* options;
+			std::atomic<uint64_t> seen; // Generation caught up with, or idle
+			char padding[64 - sizeof(std::atomic<uint64_t>)]; // One cache line per reader
+			bool open = true; // With the writer lock held
+
+			Reader(ReloadableOptions* options, uint64_t generation) : options(options), seen(generation){}
+		public:
+			// The latest snapshot, valid until this reader quiesces or releases
+			const Snapshot* read() const
+			{
+				return options->latest.load(std::memory_order_acquire);
+			}
+
+			// Declares the snapshots read so far out of use, and brings an idle
+			// reader back. Records the latest generation, then checks it is
+			// still the latest: a reload in between may have missed the record.
+			void quiesce()
+			{
+				auto generation = options->published.load();
+				for(;;)
+				{
+					seen.store(generation);
+					auto again = options->published.load();
+					if(again == generation)
+						return;
+					generation = again;
+				}
+			}
+
+			// Declares the snapshots read so far out of use, for a reader that
+			// is going idle; quiesce() before reading again
+			void release()
+			{
+				seen.store(idle);
+			}
+
+			// Releases this reader and gives it back for reader() to reuse; the
+			// thread must not use it afterwards
+			void close()
+			{
+				std::lock_guard<std::mutex> lock(options->writer);
+				seen.store(idle);
+				open = false;
+			}
+		};
+
+		// Loads @path right away; every snapshot starts from @defaults. Watches
+		// before loading, so that no change in between goes unseen.
+		ReloadableOptions(std::string path, Binder binder, T defaults = T())
+			: path(std::move(path)), binder(std::move(binder)), defaults(std::move(defaults))
+		{
+			startWatching();
+			reload();
+		}
+
+		~ReloadableOptions()
+		{
+			delete latest.load();
+			for(auto snapshot : retired)
+				delete snapshot;
+		}
+
+		ReloadableOptions(const ReloadableOptions&) = delete;
+		ReloadableOptions& operator=(const ReloadableOptions&) = delete;
+
+		// The latest snapshot, valid until the next reload. Only the thread that
+		// reloads may use it; other threads read through a Reader.
+		const Snapshot* current() const
+		{
+			return latest.load(std::memory_order_acquire);
+		}
+
+		// Registers a reader, caught up with the latest snapshot. It lives as
+		// long as these options, or until it is closed; closed readers are
+		// handed out again before any new one is made.
+		Reader& reader()
+		{
+			std::lock_guard<std::mutex> lock(writer);
+			auto generation = published.load(std::memory_order_relaxed);
+			for(auto& r : readers)
+				if(!r->open)
+				{
+					r->open = true;
+					r->seen.store(generation);
+					return *r;
+				}
+			readers.push_back(std::unique_ptr<Reader>(new Reader(this, generation)));
+			return *readers.back();
+		}
+
+		// Reloads if the file changed since the last check; returns whether a
+		// new snapshot was published
+		bool poll()
+		{
+			std::lock_guard<std::mutex> lock(writer);
+			if(!fileChanged())
+				return false;
+			publish();
+			return true;
+		}
+
+		// Parses the file into a new snapshot and publishes it
+		void reload()
+		{
+			std::lock_guard<std::mutex> lock(writer);
+			publish();
+		}
+
+		// Frees the replaced snapshots that no reader pins
+		void reclaim()
+		{
+			std::lock_guard<std::mutex> lock(writer);
+			reclaimUnpinned();
+		}
+
+	private:
+		std::string path;
+		Binder binder;
+		T defaults;
+		std::atomic<const Snapshot*> latest{nullptr};
+		std::atomic<uint64_t> published{0}; // Generation of latest, for readers to catch up with
+		std::vector<const Snapshot*> retired;
+		std::vector<std::unique_ptr<Reader>> readers;
+		std::mutex writer; // Serializes reloads, registration and reclaiming; reads never take it
+		std::string lastText;
+#ifdef GETOPT_INOTIFY
+		// Closes the inotify descriptor however the options go, even when the
+		// first load throws
+		struct Watch
+		{
+			int fd = -1;
+			Watch() = default;
+			Watch(const Watch&) = delete;
+			Watch& operator=(const Watch&) = delete;
+			~Watch()
+			{
+				if(fd >= 0)
+					close(fd);
+			}
+		} watch;
+		std::string fileName;
+#endif
+
+		static const uint64_t idle = std::numeric_limits<uint64_t>::max(); // Caught up with everything
+
+		// With the writer lock held
+		void publish()
+		{
+			auto text = readFile();
+			ArgVector args;
+			args.push_back(path);
+			for(auto word : splitCommandLine(text))
+				args.push_back(word.str());
+
+			std::unique_ptr<Snapshot> next(new Snapshot());
+			next->values = defaults;
+			next->result = binder(next->values, args);
+			if(args.size() > 1)
+				throw GetOptException("Unexpected argument " + args[1] + " in " + path);
+
+			auto previous = latest.load(std::memory_order_relaxed);
+			next->changed = changedOptions(previous ? previous->result : GetOptResult(), next->result);
+			next->generation = previous ? previous->generation + 1 : 0;
+			auto generation = next->generation;
+			latest.store(next.release(), std::memory_order_release);
+			published.store(generation); // Sequentially consistent, to order against quiesce()
+			if(previous)
+				retired.push_back(previous);
+			lastText = std::move(text);
+			reclaimUnpinned();
+		}
+
+		// With the writer lock held. A snapshot is replaced by the next
+		// generation, so a reader that has caught up with a later generation
+		// can no longer read it. A reader that records an older generation after
+		// this looks also sees the newer one, and records again.
+		void reclaimUnpinned()
+		{
+			uint64_t oldestSeen = idle;
+			for(auto& r : readers)
+				oldestSeen = std::min(oldestSeen, r->seen.load());
+			auto kept = retired.begin();
+			for(auto snapshot : retired)
+				if(snapshot->generation < oldestSeen)
+					delete snapshot;
+				else
+					*kept++ = snapshot;
+			retired.erase(kept, retired.end());
+		}
+
+		std::string readFile() const
+		{
+			std::ifstream file(path, std::ios::binary);
+			if(!file)
+				throw GetOptException("Cannot read options file " + path);
+			return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		// Watches the file's directory rather than the file, so that editors
+		// and deploy tools that replace the file by renaming over it are seen
+		void startWatching()
+		{
+#ifdef GETOPT_INOTIFY
+			auto slash = path.rfind('/');
+			std::string directory = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+			fileName = (slash == std::string::npos) ? path : path.substr(slash + 1);
+			watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if(watch.fd >= 0 && inotify_add_watch(watch.fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+			{
+				close(watch.fd);
+				watch.fd = -1;
+			}
+#endif
+		}
+
+		// Drains pending file events; without inotify, compares the contents
+		bool fileChanged()
+		{
+#ifdef GETOPT_INOTIFY
+			if(watch.fd >= 0)
+			{
+				bool changed = false;
+				alignas(inotify_event) char buffer[4096];
+				ssize_t length;
+				while((length = read(watch.fd, buffer, sizeof(buffer))) > 0)
+					for(char* p = buffer; p < buffer + length;)
+					{
+						auto event = reinterpret_cast<const inotify_event*>(p);
+						if(event->len && fileName == event->name)
+							changed = true;
+						p += sizeof(inotify_event) + event->len;
+					}
+				return changed;
+			}
+#endif
+			return readFile() != lastText;
+		}
+	};
+}
+#endif
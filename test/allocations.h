@@ -0,0 +1,93 @@
+/**
+ * allocations.h
+ * Counts every allocation in a test program, for tests and benchmarks that
+ * prove a path allocates nothing. It replaces the global allocation
+ * functions, so include it in exactly one translation unit per program.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#ifndef GETOPT_TEST_ALLOCATIONS_H
+#define GETOPT_TEST_ALLOCATIONS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+std::atomic<size_t> allocations{0};
+
+// Allocation and release stay out of line, so that the compiler never sees a
+// replaced operator new paired with the free() inside a replaced delete
+#if defined(__GNUC__)
+#define GETOPT_TEST_NOINLINE __attribute__((noinline))
+#else
+#define GETOPT_TEST_NOINLINE
+#endif
+
+GETOPT_TEST_NOINLINE inline void* countedAllocation(size_t size) noexcept
+{
+	++allocations;
+	return std::malloc(size ? size : 1);
+}
+
+GETOPT_TEST_NOINLINE inline void countedRelease(void* p) noexcept
+{
+	std::free(p);
+}
+
+void* operator new(size_t size)
+{
+	if(void* p = countedAllocation(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	if(void* p = countedAllocation(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocation(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocation(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	countedRelease(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	countedRelease(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	countedRelease(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	countedRelease(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept
+{
+	countedRelease(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	countedRelease(p);
+}
+#endif
+
+#endif
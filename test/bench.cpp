@@ -0,0 +1,247 @@
+/**
+ * bench.cpp
+ * Benchmarks of getopt's value conversions: plain integers, byte sizes and
+ * durations, each through the conversion alone and through whole getopt
+ * calls. Reports nanoseconds and allocations per value. Also measures UTF-8
+ * validation throughput over large response-style args.
+ *
+ * Build it optimized, e.g. g++ -std=c++11 -O2 test/bench.cpp; the optional
+ * argument scales the number of iterations.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#include "../include/getopt.h"
+#include "allocations.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Keeps results alive so that the work producing them isn't optimized out
+static volatile uint64_t sink;
+
+struct Measurement
+{
+	double nanoseconds = 0;
+	double allocations = 0;
+};
+
+// Runs @f @iterations times, each handling @values values; returns the cost per value
+template<typename F>
+Measurement measure(size_t iterations, size_t values, F f)
+{
+	f();// Warm up
+	size_t before = allocations;
+	auto started = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < iterations; ++i)
+		f();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - started;
+	Measurement m;
+	m.nanoseconds = elapsed.count() / (iterations * values);
+	m.allocations = double(allocations - before) / (iterations * values);
+	return m;
+}
+
+void report(const char* name, const Measurement& m)
+{
+	std::printf("%-40s %10.1f ns/value %8.2f allocations/value\n", name, m.nanoseconds, m.allocations);
+}
+
+// A command line giving @value to option --value @count times
+struct RepeatedOption
+{
+	std::vector<std::string> words;
+	std::vector<char*> argv;
+
+	RepeatedOption(const std::string& value, size_t count)
+	{
+		words.push_back("bench");
+		for(size_t i = 0; i < count; ++i)
+			words.push_back("--value=" + value);
+		for(auto& w : words)
+			argv.push_back(&w[0]);
+	}
+	int argc() { return static_cast<int>(argv.size()); }
+};
+
+// Args like large JSON responses: ASCII, or with one multibyte char in every
+// @every bytes or so when @every is nonzero
+std::vector<std::string> responseArgs(size_t count, size_t bytes, size_t every)
+{
+	static const char* const fragments[] = {"{\"id\":", "12345", ",\"name\":\"", "widget", "\",\"tags\":[", "\"a\",\"b\"", "]},"};
+	static const char* const multibyte[] = {"\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xD0\x96"};
+	std::vector<std::string> args;
+	for(size_t a = 0; a < count; ++a)
+	{
+		std::string arg;
+		arg.reserve(bytes + 8);
+		size_t next = every;
+		for(size_t f = 0; arg.size() < bytes; ++f)
+		{
+			arg += fragments[f % 7];
+			if(every && arg.size() >= next)
+			{
+				arg += multibyte[f % 4];
+				next += every;
+			}
+		}
+		args.push_back(std::move(arg));
+	}
+	return args;
+}
+
+// The byte-at-a-time check that validateUtf8 replaces
+size_t findInvalidUtf8Bytewise(GetOpt::StringView s)
+{
+	auto begin = reinterpret_cast<const unsigned char*>(s.data());
+	auto end = begin + s.size();
+	for(auto p = begin; p < end;)
+	{
+		size_t invalid;
+		size_t length = GetOpt::utf8SequenceLength(p, end, invalid);
+		if(!length)
+			return p - begin;
+		p += length;
+	}
+	return s.size();
+}
+
+void reportThroughput(const char* name, size_t bytes, size_t iterations, double seconds)
+{
+	std::printf("%-40s %10.2f GB/s\n", name, double(bytes) * iterations / seconds / 1e9);
+}
+
+template<typename F>
+double secondsFor(size_t iterations, F f)
+{
+	f();// Warm up
+	auto started = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < iterations; ++i)
+		f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+void benchUtf8(size_t scale)
+{
+	const size_t count = 16, bytes = 1 << 20;
+	size_t iterations = 20 * scale;
+	struct Input { const char* name; size_t every; } inputs[] = {{"ASCII", 0}, {"1 multibyte char per 64 bytes", 64}, {"1 multibyte char per 8 bytes", 8}};
+	for(auto& input : inputs)
+	{
+		std::printf("\nUTF-8 validation, %zu args of %zu KiB, %s\n", count, bytes >> 10, input.name);
+		auto args = responseArgs(count, bytes, input.every);
+		size_t total = 0;
+		std::vector<char*> argv = {const_cast<char*>("bench")};
+		for(auto& a : args)
+		{
+			total += a.size();
+			argv.push_back(&a[0]);
+		}
+		reportThroughput("bytewise", total, iterations, secondsFor(iterations, [&]()
+		{
+			for(auto& a : args)
+				sink = findInvalidUtf8Bytewise(a);
+		}));
+		reportThroughput("findInvalidUtf8", total, iterations, secondsFor(iterations, [&]()
+		{
+			for(auto& a : args)
+				sink = GetOpt::findInvalidUtf8(a);
+		}));
+		reportThroughput("getopt with config::validateUtf8", total, iterations, secondsFor(iterations, [&]()
+		{
+			auto results = GetOpt::getopt(static_cast<int>(argv.size()), argv.data()
+				, GetOpt::config::validateUtf8, GetOpt::config::keepTailInPlace
+				, GetOpt::config::stopOnFirstNonOption);
+			sink = results.tail.size();
+		}));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t scale = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1;
+	size_t iterations = 200000 * (scale ? scale : 1);
+	const size_t perCall = 256;
+
+	std::printf("Conversions alone\n");
+	{
+		std::string text = "123456789";
+		int64_t value = 0;
+		report("int64_t \"123456789\"", measure(iterations, 1, [&]()
+		{
+			GetOpt::getoptassign(&value, text);
+			sink = value;
+		}));
+	}
+	{
+		std::string text = "512MiB";
+		uint64_t value = 0;
+		report("byteSize \"512MiB\"", measure(iterations, 1, [&]()
+		{
+			GetOpt::getoptassign(GetOpt::byteSize(&value), text);
+			sink = value;
+		}));
+	}
+	{
+		std::string text = "1.5GB";
+		uint64_t value = 0;
+		report("byteSize \"1.5GB\"", measure(iterations, 1, [&]()
+		{
+			GetOpt::getoptassign(GetOpt::byteSize(&value), text);
+			sink = value;
+		}));
+	}
+	{
+		std::string text = "250ms";
+		std::chrono::microseconds value(0);
+		report("microseconds \"250ms\"", measure(iterations, 1, [&]()
+		{
+			GetOpt::getoptassign(&value, text);
+			sink = value.count();
+		}));
+	}
+	{
+		std::string text = "1.5s";
+		std::chrono::nanoseconds value(0);
+		report("nanoseconds \"1.5s\"", measure(iterations, 1, [&]()
+		{
+			GetOpt::getoptassign(&value, text);
+			sink = value.count();
+		}));
+	}
+
+	std::printf("\nThrough getopt, %zu values per call\n", perCall);
+	size_t calls = iterations / perCall + 1;
+	{
+		RepeatedOption line("123456789", perCall);
+		int64_t value = 0;
+		report("int64_t", measure(calls, perCall, [&]()
+		{
+			GetOpt::getopt(line.argc(), line.argv.data(), "value", &value);
+			sink = value;
+		}));
+	}
+	{
+		RepeatedOption line("512MiB", perCall);
+		uint64_t value = 0;
+		report("byteSize", measure(calls, perCall, [&]()
+		{
+			GetOpt::getopt(line.argc(), line.argv.data(), "value", GetOpt::byteSize(&value));
+			sink = value;
+		}));
+	}
+	{
+		RepeatedOption line("250ms", perCall);
+		std::chrono::milliseconds value(0);
+		report("milliseconds", measure(calls, perCall, [&]()
+		{
+			GetOpt::getopt(line.argc(), line.argv.data(), "value", &value);
+			sink = value.count();
+		}));
+	}
+
+	benchUtf8(scale ? scale : 1);
+	return 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * fuzz.cpp
+ * Fuzz target for GetOpt::getopt. Every input is checked against the reference
+ * model in fuzzmodel.h, and its parse cost is compared against the same input
+ * repeated several times to catch cost that grows superlinearly.
+ *
+ * Build with -DGETOPT_LIBFUZZER and -fsanitize=fuzzer to run under libFuzzer.
+ * Without it, this builds a standalone driver that replays the regression
+ * corpus plus any input files named on the command line.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#include "fuzzmodel.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static void checkModel(const FuzzModel::FuzzCase& c)
+{
+	if(!(FuzzModel::runGetopt(c) == FuzzModel::runModel(c)))
+	{
+		std::cerr << "getopt disagrees with the reference model on "
+			<< c.args.size() << " args (config " << int(c.config) << ")" << std::endl;
+		std::abort();
+	}
+}
+
+#ifdef GETOPT_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	auto c = FuzzModel::decode(data, size);
+	checkModel(c);
+	if(size >= FuzzModel::MIN_SCALING_BYTES && FuzzModel::scalingFactor(c, nullptr) > FuzzModel::SUPERLINEAR_FACTOR)
+	{
+		std::cerr << "superlinear parse cost: ";
+		FuzzModel::scalingFactor(c, &std::cerr);
+		std::cerr << std::endl;
+		std::abort();
+	}
+	return 0;
+}
+
+#else
+
+int main(int argc, char** argv)
+{
+	int flagged = 0;
+	auto run = [&](const std::string& name, const FuzzModel::FuzzCase& c)
+	{
+		checkModel(c);
+		std::cout << name << ": ";
+		bool superlinear = FuzzModel::scalingFactor(c, &std::cout) > FuzzModel::SUPERLINEAR_FACTOR;
+		std::cout << (superlinear ? " SUPERLINEAR" : "") << std::endl;
+		flagged += superlinear;
+	};
+	for(auto& entry : FuzzModel::corpus())
+		run(entry.name, entry.build());
+	for(int i = 1; i < argc; ++i)
+	{
+		std::ifstream file(argv[i], std::ios::binary);
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		run(argv[i], FuzzModel::decode(bytes.data(), bytes.size()));
+	}
+	return flagged ? 1 : 0;
+}
+
+#endif
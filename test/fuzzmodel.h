@@ -0,0 +1,489 @@
+/**
+ * fuzzmodel.h
+ * Shared pieces of the getopt fuzz target: decoding of raw fuzz input into a
+ * command line, a deliberately naive reference model of getopt's matching
+ * rules, the check that parse cost scales linearly, and the corpus of minimized
+ * slow inputs found so far.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#ifndef GETOPTFUZZMODEL_H
+#define GETOPTFUZZMODEL_H
+
+#include "../include/getopt.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace FuzzModel
+{
+	// Bits of the first input byte select the configuration for a case
+	enum ConfigBits : uint8_t
+	{
+		PASS_THROUGH = 1 << 0,
+		CASE_SENSITIVE = 1 << 1,
+		STOP_ON_FIRST_NON_OPTION = 1 << 2,
+		KEEP_END_OF_OPTIONS = 1 << 3,
+	};
+
+	struct FuzzCase
+	{
+		uint8_t config = 0;
+		std::vector<std::string> args;
+
+		size_t byteSize() const
+		{
+			size_t size = 1;
+			for(auto& a : args)
+				size += a.size() + 1;
+			return size;
+		}
+	};
+
+	// The first byte is the config; the rest is split on NUL into args that
+	// follow a fixed program name.
+	inline FuzzCase decode(const uint8_t* data, size_t size)
+	{
+		FuzzCase c;
+		c.args.push_back("this.exe");
+		if(size == 0)
+			return c;
+		c.config = data[0];
+		std::string current;
+		for(size_t i = 1; i < size; ++i)
+		{
+			if(data[i] == '\0')
+			{
+				c.args.push_back(current);
+				current.clear();
+			}
+			else
+				current.push_back(static_cast<char>(data[i]));
+		}
+		if(size > 1)
+			c.args.push_back(current);
+		return c;
+	}
+
+	// Repeats everything after the program name @times times; used to check how
+	// parse cost scales with input size.
+	inline FuzzCase repeat(const FuzzCase& c, size_t times)
+	{
+		FuzzCase r;
+		r.config = c.config;
+		r.args.push_back(c.args.front());
+		for(size_t t = 0; t < times; ++t)
+			r.args.insert(r.args.end(), c.args.begin() + 1, c.args.end());
+		return r;
+	}
+
+	struct Values
+	{
+		std::string alpha;
+		bool beta = false;
+		int count = 0;
+		int num = 0;
+		bool help = false;
+
+		bool operator==(const Values& v) const
+		{
+			return alpha == v.alpha && beta == v.beta && count == v.count
+				&& num == v.num && help == v.help;
+		}
+	};
+
+	struct Outcome
+	{
+		bool threw = false;
+		Values values;
+		std::vector<std::string> args;
+
+		// Values are only meaningful when parsing ran to completion
+		bool operator==(const Outcome& o) const
+		{
+			if(threw || o.threw)
+				return threw == o.threw;
+			return values == o.values && args == o.args;
+		}
+	};
+
+	// The option specs exercised by every case
+	#define GETOPT_FUZZ_SPECS(values) \
+		"alpha|a", &(values).alpha, \
+		"beta|b", &(values).beta, \
+		"count|c+", &(values).count, \
+		"num|n", &(values).num
+
+	inline Outcome runGetopt(const FuzzCase& c)
+	{
+		using GetOpt::config;
+		Outcome outcome;
+		outcome.args = c.args;
+		try
+		{
+			// noBundling is a no-op here, standing in for "flag not set"
+			auto result = GetOpt::getopt(outcome.args
+				, (c.config & CASE_SENSITIVE) ? config::caseSensitive : config::noBundling
+				, (c.config & STOP_ON_FIRST_NON_OPTION) ? config::stopOnFirstNonOption : config::noBundling
+				, (c.config & KEEP_END_OF_OPTIONS) ? config::keepEndOfOptions : config::noBundling
+				, (c.config & PASS_THROUGH) ? config::passThrough : config::noPassThrough
+				, GETOPT_FUZZ_SPECS(outcome.values));
+			outcome.values.help = result.helpWanted;
+		}
+		catch(GetOpt::GetOptException&)
+		{
+			outcome.threw = true;
+		}
+		return outcome;
+	}
+
+	// Reference model
+
+	struct ModelError {};
+
+	enum class Kind { STRING, BOOL, INT };
+
+	struct ModelSpec
+	{
+		std::vector<std::string> longs;
+		std::vector<char> shorts;
+		Kind kind;
+		bool incremental;
+	};
+
+	inline void modelAssign(const ModelSpec& spec, Values& v, const std::string& content)
+	{
+		switch(spec.kind)
+		{
+			case Kind::STRING:
+				v.alpha = content;
+				break;
+			case Kind::BOOL:
+			{
+				std::string lowered = content;
+				std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+				if(lowered != "true" && lowered != "false")
+					throw ModelError();
+				(spec.longs[0] == "beta" ? v.beta : v.help) = (lowered == "true");
+				break;
+			}
+			case Kind::INT:
+			{
+				const char* begin = content.c_str();
+				char* end = nullptr;
+				errno = 0;
+				long parsed = std::strtol(begin, &end, 10);
+				if(end == begin || *end != '\0' || errno == ERANGE
+					|| parsed < INT_MIN || parsed > INT_MAX)
+					throw ModelError();
+				(spec.incremental ? v.count : v.num) = static_cast<int>(parsed);
+				break;
+			}
+		}
+	}
+
+	// Splits @arg, an option, into its name and any attached content, as
+	// getopt tokenizes it; returns whether nothing is attached
+	inline bool modelSplit(const std::string& arg, bool& isLong, std::string& name, std::string& content)
+	{
+		isLong = (arg[1] == '-');
+		if(isLong)
+		{
+			auto equals = arg.find('=');
+			bool solitary = (equals == std::string::npos);
+			name = arg.substr(2, solitary ? std::string::npos : equals - 2);
+			if(!solitary)
+				content = arg.substr(equals + 1);
+			return solitary;
+		}
+		name = arg.substr(1, 1);
+		content = arg.substr(2);
+		return arg.size() == 2;
+	}
+
+	inline bool modelMatches(const ModelSpec& spec, bool isLong, const std::string& name)
+	{
+		return isLong
+			? std::count(spec.longs.begin(), spec.longs.end(), name) > 0
+			: std::count(spec.shorts.begin(), spec.shorts.end(), name[0]) > 0;
+	}
+
+	// A direct transcription of the documented rules: each option in turn scans
+	// the remaining args, removing what it matches. With stopOnFirstNonOption,
+	// parsing ends at the first non-option after the program name that isn't
+	// the value of an option given alone before it, and the args from there on
+	// are left exactly as given. When --help or -h comes before parsing would
+	// end, only help is matched and nothing is checked.
+	inline Outcome runModel(const FuzzCase& c)
+	{
+		const std::vector<ModelSpec> specs = {
+			{{"alpha"}, {'a'}, Kind::STRING, false},
+			{{"beta"}, {'b'}, Kind::BOOL, false},
+			{{"count"}, {'c'}, Kind::INT, true},
+			{{"num"}, {'n'}, Kind::INT, false},
+			{{"help"}, {'h'}, Kind::BOOL, false},
+		};
+		bool caseSensitive = c.config & CASE_SENSITIVE;
+		bool stop = c.config & STOP_ON_FIRST_NON_OPTION;
+		auto folded = [&](std::string arg)
+		{
+			if(!caseSensitive)
+				std::transform(arg.begin(), arg.end(), arg.begin(), ::tolower);
+			return arg;
+		};
+		auto isOption = [](const std::string& arg) { return arg.size() >= 2 && arg[0] == '-'; };
+
+		Outcome outcome;
+		auto terminator = std::find(c.args.begin(), c.args.end(), std::string("--"));
+		std::list<std::string> work(c.args.begin(), terminator);
+		auto tail = work.end(); // Where parsing stopped
+		if(stop && !work.empty())
+			for(auto it = std::next(work.begin()); it != work.end(); ++it)
+			{
+				std::string arg = folded(*it);
+				if(!isOption(arg))
+				{
+					tail = it;
+					break;
+				}
+				bool isLong;
+				std::string name, content;
+				if(!modelSplit(arg, isLong, name, content))
+					continue;
+				for(auto& spec : specs)
+					if(modelMatches(spec, isLong, name))
+					{
+						if(spec.kind != Kind::BOOL && !spec.incremental && std::next(it) != work.end())
+							++it; // Its value
+						break;
+					}
+			}
+		bool helpFirst = false;
+		if(!work.empty())
+			for(auto it = std::next(work.begin()); it != tail; ++it)
+			{
+				std::string arg = folded(*it);
+				if(arg == "--help" || arg == "-h")
+				{
+					helpFirst = true;
+					break;
+				}
+			}
+		try
+		{
+			for(auto& spec : specs)
+			{
+				if(helpFirst && spec.longs[0] != "help")
+					continue;
+				for(auto it = work.begin(); it != tail;)
+				{
+					std::string arg = folded(*it);
+					if(!isOption(arg))
+					{
+						++it;
+						continue;
+					}
+					bool isLong;
+					std::string name, content;
+					bool solitary = modelSplit(arg, isLong, name, content);
+					if(!modelMatches(spec, isLong, name))
+					{
+						++it;
+						continue;
+					}
+					it = work.erase(it);
+					if(solitary)
+					{
+						if(spec.kind == Kind::BOOL)
+						{
+							modelAssign(spec, outcome.values, "true");
+							continue;
+						}
+						if(spec.incremental)
+						{
+							++outcome.values.count;
+							continue;
+						}
+						if(it == tail)
+							throw ModelError();
+						content = *it;
+						it = work.erase(it);
+					}
+					modelAssign(spec, outcome.values, content);
+				}
+			}
+			if(!(c.config & PASS_THROUGH) && !helpFirst)
+				for(auto it = work.begin(); it != tail; ++it)
+					if(isOption(*it))
+						throw ModelError();
+		}
+		catch(ModelError&)
+		{
+			outcome.threw = true;
+			return outcome;
+		}
+		outcome.args.assign(work.begin(), work.end());
+		if(terminator != c.args.end())
+			outcome.args.insert(outcome.args.end()
+				, (c.config & KEEP_END_OF_OPTIONS || tail != work.end()) ? terminator : terminator + 1
+				, c.args.end());
+		return outcome;
+	}
+
+	// Cost scaling
+
+	// How many times an input is repeated for the scaling check
+	const size_t SCALE = 4;
+	// Flag inputs whose cost per byte grows by more than this over SCALE repeats
+	const double SUPERLINEAR_FACTOR = 2.5;
+	// Inputs smaller than this are too noisy to judge
+	const size_t MIN_SCALING_BYTES = 64;
+
+	// Counts retired instructions where the kernel lets us, and falls back to
+	// elapsed nanoseconds elsewhere.
+	class CostCounter
+	{
+		int fd = -1;
+		std::chrono::steady_clock::time_point started;
+	public:
+		CostCounter()
+		{
+#ifdef __linux__
+			perf_event_attr attr = {};
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+		}
+		~CostCounter()
+		{
+#ifdef __linux__
+			if(fd >= 0)
+				close(fd);
+#endif
+		}
+
+		const char* unit() const { return fd >= 0 ? "instructions" : "ns"; }
+
+		void start()
+		{
+#ifdef __linux__
+			if(fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+				return;
+			}
+#endif
+			started = std::chrono::steady_clock::now();
+		}
+
+		uint64_t stop()
+		{
+#ifdef __linux__
+			if(fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+				uint64_t count = 0;
+				if(read(fd, &count, sizeof(count)) != sizeof(count))
+					return 0;
+				return count;
+			}
+#endif
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - started).count());
+		}
+	};
+
+	inline CostCounter& costCounter()
+	{
+		static CostCounter counter;
+		return counter;
+	}
+
+	// Best of a few runs, to keep scheduler noise out of the timing fallback
+	inline uint64_t measure(const FuzzCase& c)
+	{
+		uint64_t best = UINT64_MAX;
+		for(int i = 0; i < 3; ++i)
+		{
+			costCounter().start();
+			runGetopt(c);
+			uint64_t cost = costCounter().stop();
+			if(cost < best)
+				best = cost;
+		}
+		return best;
+	}
+
+	// Returns the growth in cost per byte between @c and @c repeated SCALE times
+	inline double scalingFactor(const FuzzCase& c, std::ostream* report)
+	{
+		auto scaled = repeat(c, SCALE);
+		double small = double(measure(c)) / c.byteSize();
+		double large = double(measure(scaled)) / scaled.byteSize();
+		double factor = small > 0 ? large / small : 0;
+		if(report)
+			*report << small << " -> " << large << ' ' << costCounter().unit()
+				<< "/byte (x" << factor << ")";
+		return factor;
+	}
+
+	// Regression corpus: minimized inputs that once made the parser's cost grow
+	// superlinearly. Each one is `pattern` repeated `count` times, then `suffix`.
+	struct CorpusEntry
+	{
+		const char* name;
+		uint8_t config;
+		std::vector<std::string> pattern;
+		size_t count;
+		std::vector<std::string> suffix;
+
+		FuzzCase build() const
+		{
+			FuzzCase c;
+			c.config = config;
+			c.args.push_back("this.exe");
+			for(size_t i = 0; i < count; ++i)
+				c.args.insert(c.args.end(), pattern.begin(), pattern.end());
+			c.args.insert(c.args.end(), suffix.begin(), suffix.end());
+			return c;
+		}
+	};
+
+	inline const std::vector<CorpusEntry>& corpus()
+	{
+		static const std::vector<CorpusEntry> entries = {
+			// Every match erased from the front of a long vector
+			{"repeated incremental flags", 0, {"-c"}, 2000, {}},
+			// Every option rescans and relowercases a long positional run
+			{"option after many positionals", 0, {"file.txt"}, 2000, {"--num=3"}},
+			{"passThrough unknown options", PASS_THROUGH, {"--unknown=VALUE"}, 2000, {}},
+			{"case-insensitive long values", 0, {"--ALPHA=Value"}, 2000, {}},
+			{"separate values", CASE_SENSITIVE, {"-a", "value", "-n", "7"}, 1000, {}},
+			{"terminator after many options", 0, {"-b"}, 2000, {"--", "-x", "tail"}},
+		};
+		return entries;
+	}
+}
+
+#endif
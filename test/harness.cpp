@@ -4,87 +4,18 @@
  * TODO: not comprehensive yet!
  * Authors: Erich Gubler, erichdongubler@gmail.com
  */
-#include "../include/getopt.h"
-#include "../include/getoptdebug.h"
-#include "../depends/cpputils/printalgorithms.h"
+#include "harness.h"
+#include "../include/getoptreload.h"
+#include "../example/batchvalidate.h"
+#include "allocations.h"
+#include "fuzzmodel.h"
 
 #include <algorithm>
-#include <iostream>
-using std::cout;
-using std::endl;
-#include <functional> 
-using std::function;
-#include <sstream>
-using std::ostringstream;
-#include <string>
-using std::string;
-#include <stdexcept>
-using std::logic_error;
-#include <vector>
-using std::vector;
-
-template<typename...Ts>
-void _fail_test(const string& testName, Ts&&...explanation_args)
-{
-	ostringstream error_message_stream;
-	writeln(error_message_stream, testName, " -- ", explanation_args...);
-	throw logic_error(error_message_stream.str());
-}
-
-void _print_test_header_(const string& testName)
-{
-	cout << "----" << testName << "----" << endl;
-}
-
-template<typename...GetOptArgs>
-GetOpt::GetOptResult _run_getopt(vector<string>& args, GetOptArgs&&...getOptArgs)
-{
-	cout << "\t**args: " << range_printer(args.begin(), args.end()) << endl;
-	GetOpt::printGetOptArgs(cout, "\t**getopt args", getOptArgs...);
-	return GetOpt::getopt(args, getOptArgs...);
-}
-
-typedef std::function<void()> SetUpFunction;
-typedef std::function<void(const string&)> TestValuesFunction;
-template<typename...GetOptArgs>
-void _test_success(const string& testName, vector<string> args, const vector<string>& expectedArgsAfter, SetUpFunction setUp, TestValuesFunction testParsedValues, GetOptArgs&&...getOptArgs)
-{
-	setUp();
-	_print_test_header_(testName);
-	try
-	{
-		auto result = _run_getopt(args, getOptArgs...);
-	}
-	catch(GetOpt::GetOptException& e)
-	{
-		cout << "****GetOpt Error: " << e.what() << endl;
-	}
-	cout << "\t**after: " << range_printer(args.begin(), args.end()) << endl;
-	cout.flush();
-	if(args != expectedArgsAfter)
-	{
-		_fail_test("expected args after getopt call to be \"", range_printer(expectedArgsAfter.begin(), expectedArgsAfter.end()));//, expectedArgsAfter.end()), "\", but is \"", range_printer(args.begin(), args.end()), "\"");
-	}
-	testParsedValues(testName);
-}
-
-template<typename...GetOptArgs>
-void _test_failure(const string& testName, vector<string> args, GetOptArgs&&...getOptArgs)
-{
-	_print_test_header_(testName);
-	try
-	{
-		auto result = _run_getopt(args, getOptArgs...);
-	}
-	catch(GetOpt::GetOptException& e)
-	{
-		cout << "\t**Caught expected error: " << e.what() << endl;
-		return;
-	}
-	throw logic_error(testName);
-}
-
-void testheader(const string& s) { cout << "==== " << s << " TEST ====" << endl; }
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 
 void testbool()
 {
@@ -241,10 +172,1023 @@ void teststring()
 	);
 }
 
+void testusage()
+{
+	testheader("USAGE");
+	int verbosity = 0;
+	string color;
+	bool pretty = false;
+	vector<string> args = {"this.exe", "-v", "file", "--verbose", "-c", "red", "--color=blue"};
+	auto result = _run_getopt(args, "verbose|v+", &verbosity, "color|c", &color, "pretty|p", &pretty);
+
+	_print_test_header_("Usage: incremental counts and positions");
+	auto& verbose = result.usage(result.optionId('v'));
+	if(verbose.count != 2 || verbose.positions != vector<size_t>{1, 3})
+		_fail_test("Usage: incremental counts and positions", "verbose seen ", verbose.count, " times");
+	_print_test_header_("Usage: last value");
+	auto& colorUsage = result.usage(1); // Ids follow the order options were given in
+	if(colorUsage.lastValue != "blue" || colorUsage.positions != vector<size_t>{4, 6})
+		_fail_test("Usage: last value", "color last value is \"", colorUsage.lastValue, "\"");
+	_print_test_header_("Usage: presence");
+	if(!result.seen("color") || result.seen('p') || !result.definedOption("pretty") || result.seen("help"))
+		_fail_test("Usage: presence", "wrong presence reported");
+}
+
+enum class Mode { fast, safe, debug };
+
+void testchoice()
+{
+	testheader("CHOICE");
+	static const GetOpt::ChoiceTable<Mode> modes = {{"fast", Mode::fast}, {"safe", Mode::safe}, {"debug", Mode::debug}};
+	Mode mode = Mode::fast;
+	SetUpFunction reset_mode = [&]() -> void
+	{
+		mode = Mode::fast;
+	};
+	auto check_mode_set = [&](Mode expectedValue) -> TestValuesFunction
+	{
+		TestValuesFunction f = [&mode, expectedValue](const string& testName)
+		{
+			if(mode != expectedValue)
+				_fail_test(testName, "mode ", int(mode), " does not match expected ", int(expectedValue));
+		};
+		return f;
+	};
+	_test_success("Choice: long opt with equals"
+		, {"this.exe", "--mode=safe"}
+		, {"this.exe"}
+		, reset_mode
+		, check_mode_set(Mode::safe)
+		, "mode|m", GetOpt::choice(&mode, modes)
+	);
+	_test_success("Choice: short opt with second arg, case-insensitive"
+		, {"this.exe", "-m", "DEBUG"}
+		, {"this.exe"}
+		, reset_mode
+		, check_mode_set(Mode::debug)
+		, "mode|m", GetOpt::choice(&mode, modes)
+	);
+	_test_failure("Choice: fail unknown choice"
+		, {"this.exe", "--mode=slow"}
+		, "mode|m", GetOpt::choice(&mode, modes)
+	);
+
+	_print_test_header_("Choice: error lists choices");
+	vector<string> args = {"this.exe", "--mode=slow"};
+	try
+	{
+		GetOpt::getopt(args, "mode|m", GetOpt::choice(&mode, modes));
+		_fail_test("Choice: error lists choices", "no error");
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		if(string(e.what()).find("fast|safe|debug") == string::npos)
+			_fail_test("Choice: error lists choices", "got \"", e.what(), "\"");
+	}
+
+	_print_test_header_("Choice: values of other types");
+	{
+		static const GetOpt::ChoiceTable<string> levels = {{"low", "-O1"}, {"high", "-O3"}};
+		string level;
+		vector<string> given = {"this.exe", "--level=HIGH"};
+		vector<string> spelled = {"this.exe", "-l", "high"};
+		auto a = GetOpt::getopt(given, "level|l", GetOpt::choice(&level, levels)).fingerprint;
+		auto b = GetOpt::getopt(spelled, "level|l", GetOpt::choice(&level, levels)).fingerprint;
+		if(level != "-O3" || a != b)
+			_fail_test("Choice: values of other types", "level ", level, ", fingerprints ", a == b ? "agree" : "differ");
+	}
+
+	_print_test_header_("Choice: help lists choices");
+	args = {"this.exe"};
+	auto result = GetOpt::getopt(args, "mode|m", "Run mode", GetOpt::choice(&mode, modes));
+	ostringstream help;
+	GetOpt::defaultGetoptPrinter(help, "Usage:", result.options);
+	if(help.str().find("Run mode (fast|safe|debug)") == string::npos)
+		_fail_test("Choice: help lists choices", "got \"", help.str(), "\"");
+}
+
+void testsink()
+{
+	testheader("SINK");
+	vector<string> defines;
+	vector<size_t> positions;
+	auto defineSink = GetOpt::sink([&](GetOpt::StringView value, size_t position)
+	{
+		defines.push_back(value.str());
+		positions.push_back(position);
+	});
+	SetUpFunction reset_defines = [&]() -> void
+	{
+		defines.clear();
+		positions.clear();
+	};
+	TestValuesFunction check_defines = [&](const string& testName)
+	{
+		if(defines != vector<string>{"A=1", "B=2", "C=3"})
+			_fail_test(testName, "sink received ", range_printer(defines.begin(), defines.end()));
+		if(positions != vector<size_t>{1, 4, 5})
+			_fail_test(testName, "sink positions ", range_printer(positions.begin(), positions.end()));
+	};
+	_test_success("Sink: values streamed in order with positions"
+		, {"this.exe", "--define", "A=1", "file", "-DB=2", "--define=C=3"}
+		, {"this.exe", "file"}
+		, reset_defines
+		, check_defines
+		, GetOpt::config::caseSensitive
+		, "define|D", defineSink
+	);
+}
+
+void testsession()
+{
+	testheader("SESSION");
+	string file, level;
+	int verbosity = 0;
+	bool force = false;
+
+	_print_test_header_("Session: stages share one token stream");
+	vector<string> args = {"this.exe", "-v", "--file=a.txt", "input", "--level", "debug", "-f", "--", "-v"};
+	GetOpt::ParseSession session(args);
+	auto io = session.parse("file", &file, "force|f", &force);
+	auto logging = session.parse("verbose|v+", &verbosity, "level|l", &level);
+	auto result = session.finish();
+	if(file != "a.txt" || level != "debug" || verbosity != 1 || !force)
+		_fail_test("Session: stages share one token stream", "values ", file, ' ', level, ' ', verbosity, ' ', force);
+	if(args != vector<string>{"this.exe", "input", "-v"})
+		_fail_test("Session: stages share one token stream", "args after ", range_printer(args.begin(), args.end()));
+	if(logging.usage(logging.optionId('v')).positions != vector<size_t>{1}
+		|| io.usage(io.optionId("file")).positions != vector<size_t>{2})
+		_fail_test("Session: stages share one token stream", "positions are not indices into the original args");
+	if(!result.definedOption("help"))
+		_fail_test("Session: stages share one token stream", "builtin help missing");
+
+	_print_test_header_("Session: unrecognized options checked once, at the end");
+	vector<string> unknown = {"this.exe", "--file=a.txt", "-x"};
+	GetOpt::ParseSession failing(unknown);
+	failing.parse("file", &file);
+	failing.parse("level|l", &level);
+	try
+	{
+		failing.finish();
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+		return;
+	}
+	_fail_test("Session: unrecognized options checked once, at the end", "-x was accepted");
+}
+
+static int registeredPort = 0;
+static bool registeredVerbose = false;
+GETOPT_OPTION(port, "port|p", "Port to listen on", &registeredPort);
+GETOPT_OPTION(verbose, "verbose", "Chatty output", &registeredVerbose);
+
+void testregistry()
+{
+	testheader("REGISTRY");
+	auto run = [](vector<string> args) -> GetOpt::GetOptResultAndArgs
+	{
+		vector<char*> argv;
+		for(auto& a : args)
+			argv.push_back(&a[0]);
+		return GetOpt::getoptRegistered(static_cast<int>(argv.size()), argv.data());
+	};
+
+	_print_test_header_("Registry: one parse over every registered option");
+	auto& compiled = GetOpt::registeredOptions();
+	if(compiled.options.size() != 3 || !compiled.definedOption('p') || !compiled.definedOption("help"))
+		_fail_test("Registry: one parse over every registered option", "compiled ", compiled.options.size(), " options");
+	auto results = run({"this.exe", "--port=8080", "input", "--verbose"});
+	if(registeredPort != 8080 || !registeredVerbose || results.result.helpWanted)
+		_fail_test("Registry: one parse over every registered option", "values ", registeredPort, ' ', registeredVerbose);
+	if(results.args != vector<string>{"this.exe", "input"})
+		_fail_test("Registry: one parse over every registered option", "args after ", range_printer(results.args.begin(), results.args.end()));
+
+	_print_test_header_("Registry: help first");
+	results = run({"this.exe", "--port=x", "--help"});
+	if(!results.result.helpWanted || registeredPort != 8080)
+		_fail_test("Registry: help first", "port ", registeredPort);
+
+	_print_test_header_("Registry: UTF-8 validation");
+	{
+		vector<string> args = {"this.exe", "--verbose", "caf\xC3"};
+		vector<char*> argv;
+		for(auto& a : args)
+			argv.push_back(&a[0]);
+		try
+		{
+			GetOpt::getoptRegistered(static_cast<int>(argv.size()), argv.data(), {GetOpt::config::validateUtf8});
+			_fail_test("Registry: UTF-8 validation", "invalid UTF-8 was accepted");
+		}
+		catch(GetOpt::GetOptException& e)
+		{
+			cout << "\t**Caught expected error: " << e.what() << endl;
+		}
+		auto repaired = GetOpt::getoptRegistered(static_cast<int>(argv.size()), argv.data(), {GetOpt::config::replaceInvalidUtf8});
+		if(repaired.args != vector<string>{"this.exe", "caf\xEF\xBF\xBD"})
+			_fail_test("Registry: UTF-8 validation", "args after ", range_printer(repaired.args.begin(), repaired.args.end()));
+	}
+
+	_print_test_header_("Registry: every option scans up to a stop");
+	{
+		registeredPort = 0;
+		registeredVerbose = false;
+		vector<string> args = {"this.exe", "-p", "9", "--verbose", "file", "--port=1"};
+		vector<char*> argv;
+		for(auto& a : args)
+			argv.push_back(&a[0]);
+		auto stopped = GetOpt::getoptRegistered(static_cast<int>(argv.size()), argv.data(), {GetOpt::config::stopOnFirstNonOption});
+		if(registeredPort != 9 || !registeredVerbose || stopped.args != vector<string>{"this.exe", "file", "--port=1"})
+			_fail_test("Registry: every option scans up to a stop", "values ", registeredPort, ' ', registeredVerbose
+				, ", args after ", range_printer(stopped.args.begin(), stopped.args.end()));
+	}
+
+	_print_test_header_("Registry: unrecognized options");
+	try
+	{
+		run({"this.exe", "--bogus"});
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+		return;
+	}
+	_fail_test("Registry: unrecognized options", "--bogus was accepted");
+}
+
+struct ReloadTestOptions
+{
+	int port = 80;
+	string root = ".";
+	bool verbose = false;
+};
+
+void testreload()
+{
+	testheader("RELOAD");
+	const string path = "getopt-reload-test.conf";
+	auto write = [&](const string& text)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << text;
+	};
+
+	_print_test_header_("Reload: snapshots and changed options");
+	write("--port=8080\n--root '/srv/www'\n");
+	{
+		GetOpt::ReloadableOptions<ReloadTestOptions> options(path, [](ReloadTestOptions& o, GetOpt::ArgVector& args)
+		{
+			return GetOpt::getopt(args, "port|p", &o.port, "root", &o.root, "verbose|v", &o.verbose);
+		});
+		auto& reader = options.reader();
+		auto first = reader.read();
+		if(first->values.port != 8080 || first->values.root != "/srv/www" || first->changed != vector<size_t>{0, 1})
+			_fail_test("Reload: snapshots and changed options", "first snapshot ", first->values.port, ' ', first->values.root);
+		if(options.poll())
+			_fail_test("Reload: snapshots and changed options", "reloaded an unchanged file");
+
+		write("--port=8080\n-v\n");
+		if(!options.poll())
+			_fail_test("Reload: snapshots and changed options", "missed a change");
+		auto second = options.current();
+		if(second->generation != 1 || second->values.root != "." || !second->values.verbose
+			|| second->changed != vector<size_t>{1, 2})
+			_fail_test("Reload: snapshots and changed options", "second snapshot changed ", range_printer(second->changed.begin(), second->changed.end()));
+		if(first->values.port != 8080 || reader.read() != second)
+			_fail_test("Reload: snapshots and changed options", "pinned snapshot was freed");
+
+		_print_test_header_("Reload: values compare as converted");
+		write("--port=08080\n-v\n");
+		if(!options.poll())
+			_fail_test("Reload: values compare as converted", "missed a change");
+		auto third = options.current();
+		if(third->values.port != 8080 || !third->changed.empty())
+			_fail_test("Reload: values compare as converted", "changed ", range_printer(third->changed.begin(), third->changed.end()));
+
+		_print_test_header_("Reload: a bad file keeps the current snapshot");
+		write("--port=eighty\n");
+		try
+		{
+			options.poll();
+			_fail_test("Reload: a bad file keeps the current snapshot", "bad file was accepted");
+		}
+		catch(GetOpt::GetOptException& e)
+		{
+			cout << "\t**Caught expected error: " << e.what() << endl;
+		}
+		if(options.current() != third)
+			_fail_test("Reload: a bad file keeps the current snapshot", "snapshot was replaced");
+		reader.release();
+		options.reclaim();
+	}
+
+	_print_test_header_("Reload: replaced snapshots wait for every reader to quiesce");
+	write("--port=1\n");
+	{
+		GetOpt::ReloadableOptions<ReloadTestOptions> options(path, [](ReloadTestOptions& o, GetOpt::ArgVector& args)
+		{
+			return GetOpt::getopt(args, "port|p", &o.port, "root", &o.root, "verbose|v", &o.verbose);
+		});
+		auto& busy = options.reader();
+		auto& idle = options.reader();
+		auto first = busy.read();
+		idle.read();
+		write("--port=2\n");
+		options.reload();
+		idle.quiesce();
+		options.reclaim();
+		if(first->values.port != 1 || busy.read()->values.port != 2)
+			_fail_test("Reload: replaced snapshots wait for every reader to quiesce", "port ", first->values.port);
+		busy.quiesce();
+		idle.release();
+		options.reclaim();
+
+		_print_test_header_("Reload: closed readers are handed out again");
+		busy.close();
+		auto& next = options.reader();
+		if(&next != &busy || next.read()->values.port != 2)
+			_fail_test("Reload: closed readers are handed out again", "a new reader was made");
+		next.close();
+		idle.quiesce();
+		idle.close();
+	}
+
+	_print_test_header_("Reload: a file that fails to load throws from the constructor");
+	write("--port=eighty\n");
+	try
+	{
+		GetOpt::ReloadableOptions<ReloadTestOptions> options(path, [](ReloadTestOptions& o, GetOpt::ArgVector& args)
+		{
+			return GetOpt::getopt(args, "port|p", &o.port);
+		});
+		_fail_test("Reload: a file that fails to load throws from the constructor", "bad file was accepted");
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+	}
+	std::remove(path.c_str());
+}
+
+void testfingerprint()
+{
+	testheader("FINGERPRINT");
+	auto fingerprint = [](vector<string> args) -> GetOpt::Fingerprint
+	{
+		string file;
+		int level = 0, verbosity = 0;
+		double ratio = 0;
+		bool fast = false;
+		vector<string> defines;
+		return GetOpt::getopt(args, GetOpt::config::caseSensitive
+			, "file|f", &file, "level|l", &level, "ratio", &ratio, "fast", &fast
+			, "define|D", GetOpt::sink([&](GetOpt::StringView value, size_t) { defines.push_back(value.str()); })
+			, GetOpt::config::excludeFromFingerprint, "verbose|v+", &verbosity).fingerprint;
+	};
+	auto base = fingerprint({"this.exe", "--file=a.txt", "-l", "3", "--ratio=0.5", "-DX", "-DY"});
+	auto same = [&](const string& testName, vector<string> args, bool expected)
+	{
+		_print_test_header_(testName);
+		if((fingerprint(args) == base) != expected)
+			_fail_test(testName, expected ? "fingerprint differs" : "fingerprint collides");
+	};
+	same("Fingerprint: order and spelling don't matter", {"this.exe", "--ratio", "0.50", "--level=03", "-DX", "-fa.txt", "-DY"}, true);
+	same("Fingerprint: last value wins", {"this.exe", "-l", "9", "--file=a.txt", "-l3", "--ratio=.5", "-DX", "-DY"}, true);
+	same("Fingerprint: excluded options don't count", {"this.exe", "-v", "--file=a.txt", "-v", "-l", "3", "--ratio=0.5", "-DX", "-DY"}, true);
+	same("Fingerprint: values matter", {"this.exe", "--file=b.txt", "-l", "3", "--ratio=0.5", "-DX", "-DY"}, false);
+	same("Fingerprint: presence matters", {"this.exe", "--file=a.txt", "-l", "3", "--ratio=0.5", "-DX", "-DY", "--fast"}, false);
+	same("Fingerprint: every sink value matters", {"this.exe", "--file=a.txt", "-l", "3", "--ratio=0.5", "-DY", "-DX"}, false);
+	same("Fingerprint: values stay with their options", {"this.exe", "--file=3", "-l", "0", "--ratio=0.5", "-DX", "-DY"}, false);
+}
+
+void testtail()
+{
+	testheader("TAIL");
+	int verbosity = 0;
+	SetUpFunction reset_verbosity = [&]() -> void
+	{
+		verbosity = 0;
+	};
+	TestValuesFunction check_verbosity = [&](const string& testName)
+	{
+		if(verbosity != 1)
+			_fail_test(testName, "verbosity ", verbosity);
+	};
+	_test_success("Tail: stopping at the first non-option leaves the rest as given"
+		, {"this.exe", "-v", "file", "-x", "--", "-v"}
+		, {"this.exe", "file", "-x", "--", "-v"}
+		, reset_verbosity
+		, check_verbosity
+		, GetOpt::config::stopOnFirstNonOption
+		, "verbose|v+", &verbosity
+	);
+
+	_print_test_header_("Tail: every option scans up to the stop");
+	{
+		bool xray = false, verbose = false;
+		int number = 0;
+		vector<string> args = {"this.exe", "-v", "-n", "7", "file", "-x"};
+		GetOpt::getopt(args, GetOpt::config::stopOnFirstNonOption
+			, "xray|x", &xray, "number|n", &number, "verbose|v", &verbose);
+		if(xray || !verbose || number != 7 || args != vector<string>{"this.exe", "file", "-x"})
+			_fail_test("Tail: every option scans up to the stop", "xray ", xray, ", verbose ", verbose
+				, ", number ", number, ", args ", range_printer(args.begin(), args.end()));
+	}
+
+	_print_test_header_("Tail: a later stage may take the stop as a value");
+	{
+		bool verbose = false;
+		string name;
+		vector<string> args = {"this.exe", "--name", "bob", "-v", "file"};
+		GetOpt::ParseSession session(args);
+		session.parse(GetOpt::config::stopOnFirstNonOption, "verbose|v", &verbose);
+		session.parse("name", &name);
+		auto result = session.finish();
+		if(!verbose || name != "bob" || args != vector<string>{"this.exe", "file"} || result.parsing)
+			_fail_test("Tail: a later stage may take the stop as a value", "verbose ", verbose
+				, ", name ", name, ", args ", range_printer(args.begin(), args.end()));
+	}
+
+	// The tails below are null pointers, which reading would crash on
+	char program[] = "this.exe", verbose[] = "-v", input[] = "input", terminator[] = "--", file[] = "file";
+	_print_test_header_("Tail: args past the terminator are never read");
+	reset_verbosity();
+	vector<char*> argv = {program, verbose, input, terminator};
+	argv.resize(100000, nullptr);
+	auto results = GetOpt::getopt(static_cast<int>(argv.size()), argv.data()
+		, GetOpt::config::keepTailInPlace, "verbose|v+", &verbosity);
+	check_verbosity("Tail: args past the terminator are never read");
+	if(results.args != vector<string>{"this.exe", "input"} || results.tail.size() != argv.size() - 4)
+		_fail_test("Tail: args past the terminator are never read", "tail of ", results.tail.size());
+
+	_print_test_header_("Tail: args past a stop are never read");
+	reset_verbosity();
+	argv = {program, verbose, file};
+	argv.resize(100000, nullptr);
+	results = GetOpt::getopt(static_cast<int>(argv.size()), argv.data()
+		, GetOpt::config::keepTailInPlace, GetOpt::config::stopOnFirstNonOption, "verbose|v+", &verbosity);
+	check_verbosity("Tail: args past a stop are never read");
+	if(results.args != vector<string>{"this.exe"} || results.tail.size() != argv.size() - 2
+		|| results.tail[0].data() != file)
+		_fail_test("Tail: args past a stop are never read", "tail is not argv in place");
+}
+
+void testpositional()
+{
+	testheader("POSITIONAL");
+	int verbosity = 0;
+	string input;
+	vector<int64_t> ids;
+	SetUpFunction reset = [&]() -> void
+	{
+		verbosity = 0;
+		input.clear();
+		ids.clear();
+	};
+	_test_success("Positional: named, then the rest, tail included"
+		, {"this.exe", "in.txt", "-v", "1", "--", "2", "-3"}
+		, {"this.exe"}
+		, reset
+		, [&](const string& testName)
+		{
+			if(verbosity != 1 || input != "in.txt" || ids != vector<int64_t>{1, 2, -3})
+				_fail_test(testName, "verbosity ", verbosity, ", input ", input, ", ", ids.size(), " ids");
+		}
+		, "verbose|v+", &verbosity
+		, GetOpt::positional("input", &input), GetOpt::positionals("ids", &ids)
+	);
+	_test_success("Positional: kept terminator stays ahead of what is left"
+		, {"this.exe", "--", "in.txt", "rest"}
+		, {"this.exe", "--", "rest"}
+		, reset
+		, [&](const string& testName)
+		{
+			if(input != "in.txt")
+				_fail_test(testName, "input ", input);
+		}
+		, GetOpt::config::keepEndOfOptions, GetOpt::positional("input", &input)
+	);
+	_test_failure("Positional: missing", {"this.exe", "-v"}
+		, "verbose|v+", &verbosity, GetOpt::positional("input", &input));
+	_test_failure("Positional: not a number", {"this.exe", "1", "2x"}, GetOpt::positionals("ids", &ids));
+	_test_failure("Positional: out of range", {"this.exe", "9223372036854775808"}, GetOpt::positionals("ids", &ids));
+
+	_print_test_header_("Positional: errors name the positional");
+	try
+	{
+		vector<string> args = {"this.exe", "in.txt", "x3"};
+		GetOpt::getopt(args, GetOpt::positional("input", &input), GetOpt::positionals("ids", &ids));
+		_fail_test("Positional: errors name the positional", "x3 was accepted");
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+		if(string(e.what()).compare(0, 15, "Positional ids:") != 0)
+			_fail_test("Positional: errors name the positional", "got \"", e.what(), "\"");
+	}
+
+	_print_test_header_("Positional: many numeric ids land in storage reserved once");
+	reset();
+	const size_t count = 300000;
+	vector<string> words;
+	words.reserve(count);
+	vector<char*> argv = {const_cast<char*>("this.exe"), const_cast<char*>("-v")};
+	for(size_t i = 0; i < count; ++i)
+	{
+		words.push_back(std::to_string(i * 7919));
+		argv.push_back(&words.back()[0]);
+	}
+	auto started = std::chrono::steady_clock::now();
+	auto results = GetOpt::getopt(static_cast<int>(argv.size()), argv.data()
+		, "verbose|v+", &verbosity, GetOpt::positionals("ids", &ids));
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+	cout << "\t**" << count << " ids in " << elapsed << " ms" << endl;
+	if(results.args != vector<string>{"this.exe"} || ids.size() != count || ids.capacity() != count)
+		_fail_test("Positional: many numeric ids", ids.size(), " ids in capacity ", ids.capacity());
+	for(size_t i = 0; i < count; ++i)
+		if(ids[i] != int64_t(i * 7919))
+			_fail_test("Positional: many numeric ids", "id ", i, " is ", ids[i]);
+}
+
+void testmove()
+{
+	testheader("MOVE");
+	char program[] = "this.exe", verbose[] = "-v", file[] = "--file=a.txt", input[] = "input";
+	char* argv[] = {program, verbose, file, input};
+	int verbosity = 0;
+	string path;
+
+	_print_test_header_("Move: results move without allocating");
+	auto parsed = GetOpt::getopt(4, argv, "verbose|v+", &verbosity, "file|f", "Input file", &path);
+	size_t before = allocations;
+	GetOpt::GetOptResultAndArgs moved(std::move(parsed));
+	GetOpt::GetOptResult result(std::move(moved.result));
+	moved.result = std::move(result);
+	GetOpt::GetOptResultAndArgs rebuilt(std::move(moved.result), std::move(moved.args));
+	if(allocations != before)
+		_fail_test("Move: results move without allocating", allocations - before, " allocations");
+	if(rebuilt.result.options.size() != 3 || rebuilt.args != vector<string>{"this.exe", "input"})
+		_fail_test("Move: results move without allocating", "lost options or args");
+
+	// Returning the result may not copy any option metadata the parse built
+	_print_test_header_("Move: getopt allocates only what the parse does");
+	before = allocations;
+	{
+		GetOpt::ParseSession session(4, argv);
+		auto result = session.parse("verbose|v+", &verbosity, "file|f", "Input file", &path);
+		session.finish(result);
+		auto args = std::move(session.remainingArgs());
+	}
+	size_t parseOnly = allocations - before;
+	before = allocations;
+	{
+		auto results = GetOpt::getopt(4, argv, "verbose|v+", &verbosity, "file|f", "Input file", &path);
+	}
+	size_t whole = allocations - before;
+	cout << "\t**parse: " << parseOnly << " allocations, getopt: " << whole << endl;
+	if(whole != parseOnly)
+		_fail_test("Move: getopt allocates only what the parse does", whole, " allocations against ", parseOnly);
+}
+
+// A value type whose conversions are counted, standing in for an expensive one
+struct CountedConversion
+{
+	static size_t conversions;
+	int value = 0;
+};
+size_t CountedConversion::conversions = 0;
+
+std::istream& operator>>(std::istream& is, CountedConversion& c)
+{
+	++CountedConversion::conversions;
+	return is >> c.value;
+}
+
+void testhelpfirst()
+{
+	testheader("HELP FIRST");
+	CountedConversion level;
+	string name, host;
+	bool ownHelp = false;
+
+	_print_test_header_("Help first: nothing is converted, required or unrecognized");
+	vector<string> args = {"this.exe", "--level=3", "--unknown", "--help", "-l", "x"};
+	auto result = GetOpt::getopt(args, "level|l", &level
+		, GetOpt::config::required, "name", &name);
+	if(!result.helpWanted || CountedConversion::conversions != 0
+		|| args != vector<string>{"this.exe", "--level=3", "--unknown", "-l", "x"})
+		_fail_test("Help first", CountedConversion::conversions, " conversions");
+
+	_test_success("Help first: a help option of one's own is still set"
+		, {"this.exe", "-H", "--level=x"}
+		, {"this.exe", "--level=x"}
+		, [&]() { ownHelp = false; }
+		, [&](const string& testName)
+		{
+			if(!ownHelp || CountedConversion::conversions != 0)
+				_fail_test(testName, "own help not set");
+		}
+		, "level|l", &level, "help|h", &ownHelp
+	);
+	_test_success("Help first: -h taken by another option is not help"
+		, {"this.exe", "-h", "example.com"}
+		, {"this.exe"}
+		, [&]() { host.clear(); }
+		, [&](const string& testName)
+		{
+			if(host != "example.com")
+				_fail_test(testName, "host ", host);
+		}
+		, "host|h", &host
+	);
+	_test_failure("Help first: not past the terminator", {"this.exe", "--level=x", "--", "--help"}, "level|l", &level);
+
+	_print_test_header_("Help first: -h of a later stage is not help");
+	{
+		bool verbose = false;
+		host.clear();
+		vector<string> stageArgs = {"this.exe", "-h", "example.com"};
+		GetOpt::ParseSession session(stageArgs);
+		session.parse("verbose|v", &verbose);
+		session.parse("host|h", &host);
+		auto stages = session.finish();
+		if(host != "example.com" || stages.helpWanted)
+			_fail_test("Help first: -h of a later stage is not help", "host ", host);
+	}
+}
+
+void testunits()
+{
+	testheader("UNITS");
+	uint64_t cache = 0;
+	int32_t rate = 0;
+	std::chrono::milliseconds timeout(0);
+	std::chrono::seconds period(0);
+	std::chrono::duration<double> seconds(0);
+	SetUpFunction reset = [&]() -> void
+	{
+		cache = 0;
+		rate = 0;
+		timeout = std::chrono::milliseconds(0);
+		period = std::chrono::seconds(0);
+		seconds = std::chrono::duration<double>(0);
+	};
+	auto check = [&](const string& testName, uint64_t expectedCache, int32_t expectedRate
+		, int64_t expectedTimeout, int64_t expectedPeriod, double expectedSeconds)
+	{
+		if(cache != expectedCache || rate != expectedRate || timeout.count() != expectedTimeout
+			|| period.count() != expectedPeriod || seconds.count() != expectedSeconds)
+			_fail_test(testName, "cache ", cache, ", rate ", rate, ", timeout ", timeout.count()
+				, "ms, period ", period.count(), "s, seconds ", seconds.count());
+	};
+	_test_success("Units: IEC and SI sizes, units of time"
+		, {"this.exe", "--cache=512MiB", "--rate=10k", "--timeout=250ms", "--period=2h", "--seconds=1.5s"}
+		, {"this.exe"}
+		, reset
+		, [&](const string& testName) { check(testName, 536870912, 10000, 250, 7200, 1.5); }
+		, "cache", GetOpt::byteSize(&cache), "rate", GetOpt::byteSize(&rate)
+		, "timeout", &timeout, "period", &period, "seconds", &seconds
+	);
+	_test_success("Units: fractions, bare numbers, truncation, case as given"
+		, {"this.exe", "--cache=1.5GB", "--rate=2", "--timeout=1.5s", "--period=90", "--seconds=250MS"}
+		, {"this.exe"}
+		, reset
+		, [&](const string& testName) { check(testName, 1500000000, 2, 1500, 90, 0.25); }
+		, GetOpt::config::caseSensitive
+		, "cache", GetOpt::byteSize(&cache), "rate", GetOpt::byteSize(&rate)
+		, "timeout", &timeout, "period", &period, "seconds", &seconds
+	);
+	_test_success("Units: finer than the target truncates"
+		, {"this.exe", "--timeout=1999us", "--period=59999ms"}
+		, {"this.exe"}
+		, reset
+		, [&](const string& testName) { check(testName, 0, 0, 1, 59, 0); }
+		, "timeout", &timeout, "period", &period
+	);
+	_test_failure("Units: 16EiB overflows 64 bits", {"this.exe", "--cache=16EiB"}, "cache", GetOpt::byteSize(&cache));
+	_test_failure("Units: 3GB overflows int32_t", {"this.exe", "--rate=3GB"}, "rate", GetOpt::byteSize(&rate));
+	_test_failure("Units: unknown size suffix", {"this.exe", "--cache=12XB"}, "cache", GetOpt::byteSize(&cache));
+	_test_failure("Units: negative size", {"this.exe", "--cache=-1k"}, "cache", GetOpt::byteSize(&cache));
+	_test_failure("Units: unknown unit of time", {"this.exe", "--timeout=5y"}, "timeout", &timeout);
+	_test_failure("Units: duration too long", {"this.exe", "--timeout=300000000000d"}, "timeout", &timeout);
+
+	_print_test_header_("Units: errors name the option");
+	vector<string> args = {"this.exe", "--timeout=soon"};
+	try
+	{
+		GetOpt::getopt(args, "timeout", &timeout);
+		_fail_test("Units: errors name the option", "no error");
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+		if(string(e.what()).find("timeout") == string::npos)
+			_fail_test("Units: errors name the option", "got \"", e.what(), "\"");
+	}
+
+	_print_test_header_("Units: conversions allocate nothing");
+	std::string value = "512MiB", duration = "250ms";
+	size_t before = allocations;
+	GetOpt::getoptassign(GetOpt::byteSize(&cache), value);
+	GetOpt::getoptassign(&timeout, duration);
+	if(allocations != before || cache != 536870912 || timeout.count() != 250)
+		_fail_test("Units: conversions allocate nothing", allocations - before, " allocations");
+}
+
+void testutf8()
+{
+	testheader("UTF-8");
+	string name;
+	SetUpFunction reset = [&]() -> void
+	{
+		name.clear();
+	};
+	_test_success("UTF-8: valid multibyte args pass"
+		, {"this.exe", "--name=na\xC3\xAFve \xE2\x82\xAC \xF0\x9F\x98\x80", "caf\xC3\xA9"}
+		, {"this.exe", "caf\xC3\xA9"}
+		, reset
+		, [&](const string& testName)
+		{
+			if(name != "na\xC3\xAFve \xE2\x82\xAC \xF0\x9F\x98\x80")
+				_fail_test(testName, "name ", name);
+		}
+		, GetOpt::config::validateUtf8, "name", &name
+	);
+	const vector<string> invalid = {
+		"\xC0\xAF", // Overlong '/'
+		"\xED\xA0\x80", // Surrogate
+		"\xF4\x90\x80\x80", // Past U+10FFFF
+		"\xE2\x82", // Truncated
+		"\x80", // Stray continuation
+		"\xFF",
+	};
+	for(auto& bad : invalid)
+		_test_failure("UTF-8: invalid sequence", {"this.exe", "ok", "long enough to need a vector " + bad}
+			, GetOpt::config::validateUtf8, "name", &name);
+
+	_print_test_header_("UTF-8: errors name the arg and byte");
+	vector<string> args = {"this.exe", "fine", "0123456789abcdef0123\xE2\x28\xA1"};
+	try
+	{
+		GetOpt::getopt(args, GetOpt::config::validateUtf8, "name", &name);
+		_fail_test("UTF-8: errors name the arg and byte", "no error");
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+		if(string(e.what()) != "Arg 2 is not valid UTF-8 at byte 20")
+			_fail_test("UTF-8: errors name the arg and byte", "got \"", e.what(), "\"");
+	}
+
+	_test_success("UTF-8: replacement of maximal subparts"
+		, {"this.exe", "--name=a\xC0\xAF" "b", "\xED\xA0\x80|\xE2\x82", "good"}
+		, {"this.exe", "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD|\xEF\xBF\xBD", "good"}
+		, reset
+		, [&](const string& testName)
+		{
+			if(name != "a\xEF\xBF\xBD\xEF\xBF\xBD" "b")
+				_fail_test(testName, "name ", name);
+		}
+		, GetOpt::config::replaceInvalidUtf8, "name", &name
+	);
+
+	_print_test_header_("UTF-8: replacement copies only invalid args");
+	char program[] = "this.exe", good[] = "caf\xC3\xA9", bad[] = "caf\xE9", terminator[] = "--";
+	char* argv[] = {program, good, bad, terminator, bad, good};
+	auto results = GetOpt::getopt(6, argv, GetOpt::config::replaceInvalidUtf8, GetOpt::config::keepTailInPlace);
+	if(results.args != vector<string>{"this.exe", "caf\xC3\xA9", "caf\xEF\xBF\xBD", "caf\xEF\xBF\xBD", "caf\xC3\xA9"}
+		|| results.tail.size() != 0)
+		_fail_test("UTF-8: replacement copies only invalid args", range_printer(results.args.begin(), results.args.end()));
+	char* repairedBeforeTail[] = {program, bad, terminator, good, good};
+	results = GetOpt::getopt(5, repairedBeforeTail, GetOpt::config::replaceInvalidUtf8, GetOpt::config::keepTailInPlace);
+	if(results.args != vector<string>{"this.exe", "caf\xEF\xBF\xBD"} || results.tail.size() != 2 || results.tail[0].data() != good)
+		_fail_test("UTF-8: replacement copies only invalid args", "valid tail not left in place");
+}
+
+void testsplit()
+{
+	testheader("SPLIT");
+	auto check = [](const string& testName, const string& line, const vector<string>& expected, size_t expectedViews)
+	{
+		_print_test_header_(testName);
+		auto words = GetOpt::splitCommandLine(line);
+		vector<string> got;
+		size_t views = 0;
+		for(auto w : words)
+		{
+			got.push_back(w.str());
+			views += (w.data() >= line.data() && w.data() <= line.data() + line.size());
+		}
+		if(got != expected)
+			_fail_test(testName, "split into ", range_printer(got.begin(), got.end()));
+		if(views != expectedViews)
+			_fail_test(testName, views, " words view the input, expected ", expectedViews);
+	};
+	check("Split: plain words view the input", "  this.exe -v\t--file=a.txt  ", {"this.exe", "-v", "--file=a.txt"}, 3);
+	check("Split: wholly quoted words view the input", "x 'a b' \"c d\" ''", {"x", "a b", "c d", ""}, 4);
+	check("Split: long plain words", "--a-fairly-long-option-name=with-a-long-value-too", {"--a-fairly-long-option-name=with-a-long-value-too"}, 1);
+	check("Split: mixed quoting is unescaped", "--file=\"a b\" x\\ y 'it'\\''s'", {"--file=a b", "x y", "it's"}, 0);
+	check("Split: double quote escapes", "\"\\$ \\\" \\a\"", {"$ \" \\a"}, 0);
+	check("Split: backslash-newline", "a\\\nb", {"ab"}, 0);
+	for(auto line : {"'open", "\"open", "trailing\\", "\"a\\\""})
+	{
+		_print_test_header_(string("Split: reject ") + line);
+		try
+		{
+			GetOpt::splitCommandLine(line);
+		}
+		catch(GetOpt::GetOptException& e)
+		{
+			cout << "\t**Caught expected error: " << e.what() << endl;
+			continue;
+		}
+		_fail_test("Split: reject", line);
+	}
+}
+
+void testcompletion()
+{
+	testheader("COMPLETION");
+	string s;
+	bool b = false;
+	auto result = GetOpt::collectOptions("color|c|colour", &s, "count|n", &s, "pretty|p", &b);
+	auto complete = [&](const vector<string>& words, size_t index) -> string
+	{
+		ostringstream os;
+		GetOpt::printCompletions(os, result.options, words, index);
+		return os.str();
+	};
+	_print_test_header_("Completion: long prefix");
+	if(complete({"this.exe", "--co"}, 1) != "--color\n--colour\n--count\n")
+		_fail_test("Completion: long prefix", "got \"", complete({"this.exe", "--co"}, 1), "\"");
+	_print_test_header_("Completion: short prefix");
+	if(complete({"this.exe", "-p"}, 1) != "-p\n")
+		_fail_test("Completion: short prefix", "got \"", complete({"this.exe", "-p"}, 1), "\"");
+	_print_test_header_("Completion: positional left to the shell");
+	if(!complete({"this.exe", "fi"}, 1).empty())
+		_fail_test("Completion: positional left to the shell", "expected no completions");
+	_print_test_header_("Completion: zsh values");
+	ostringstream zsh;
+	GetOpt::printCompletionScript(zsh, "zsh", "this.exe", result.options);
+	if(zsh.str().find("'-n+[]:value:'") == string::npos || zsh.str().find("'--count=[]:value:'") == string::npos
+		|| zsh.str().find("'-p[]'") == string::npos)
+		_fail_test("Completion: zsh values", "got \"", zsh.str(), "\"");
+
+	_print_test_header_("Completion: schema leaves parsing alone");
+	ostringstream image;
+	GetOpt::writeOptionSchema(image, result.options);
+	auto bytes = image.str();
+	GetOpt::OptionSchema schema(bytes.data(), bytes.size());
+	bool pretty = false;
+	vector<string> args = {"this.exe", "-p"};
+	GetOpt::getopt(args, GetOpt::completeFrom(schema), "pretty|p", &pretty);
+	if(!pretty || GetOpt::completionSchema(GetOpt::completeFrom(schema), "pretty|p", &pretty) != &schema)
+		_fail_test("Completion: schema leaves parsing alone", "expected -p parsed and the schema found");
+}
+
+void testschema()
+{
+	testheader("SCHEMA");
+	string s;
+	bool b = false;
+	int i = 0;
+	auto result = GetOpt::collectOptions(
+		"color|c|colour", "Output color", &s, "verbose|v+", &i, "pretty|p", &b);
+	ostringstream image;
+	GetOpt::writeOptionSchema(image, result.options);
+	auto bytes = image.str();
+
+	_print_test_header_("Schema: round trip");
+	GetOpt::OptionSchema schema(bytes.data(), bytes.size());
+	if(schema.size() != result.options.size())
+		_fail_test("Schema: round trip", "expected ", result.options.size(), " options, got ", schema.size());
+	auto color = schema.findLong("colour");
+	if(color != 0 || schema.findShort('c') != 0 || schema[color].help() != "Output color"
+		|| schema[color].type() != GetOpt::ValueType::string)
+		_fail_test("Schema: round trip", "color option did not survive");
+	auto verbose = schema.findShort('v');
+	if(verbose != 1 || !schema[verbose].isIncremental() || schema[verbose].type() != GetOpt::ValueType::integral
+		|| schema[verbose].valueSize() != sizeof(int) || !schema[verbose].valueSigned())
+		_fail_test("Schema: round trip", "verbose option did not survive");
+	if(schema.findLong("colo") != GetOpt::OptionSchema::npos || schema.findShort('x') != GetOpt::OptionSchema::npos)
+		_fail_test("Schema: round trip", "found an option that was never defined");
+
+	_print_test_header_("Schema: completion");
+	ostringstream completions;
+	GetOpt::printCompletions(completions, schema, {"this.exe", "--co"}, 1);
+	if(completions.str() != "--color\n--colour\n")
+		_fail_test("Schema: completion", "got \"", completions.str(), "\"");
+
+	_print_test_header_("Schema: bad offsets rejected");
+	{
+		// Points the first option's help past the strings, with a hash to match
+		auto forged = bytes;
+		GetOpt::SchemaOption record;
+		auto at = sizeof(GetOpt::SchemaHeader);
+		std::memcpy(&record, &forged[at], sizeof(record));
+		record.helpOffset = 0xFFFFFFF0;
+		std::memcpy(&forged[at], &record, sizeof(record));
+		GetOpt::SchemaHeader header;
+		std::memcpy(&header, forged.data(), sizeof(header));
+		header.hash = GetOpt::schemaHash(&forged[at], forged.size() - at);
+		std::memcpy(&forged[0], &header, sizeof(header));
+		try
+		{
+			GetOpt::OptionSchema forgery(forged.data(), forged.size());
+			_fail_test("Schema: bad offsets rejected", "schema with an out of bounds string was accepted");
+		}
+		catch(GetOpt::GetOptException& e)
+		{
+			cout << "\t**Caught expected error: " << e.what() << endl;
+		}
+	}
+
+	_print_test_header_("Schema: corruption rejected");
+	bytes[bytes.size() - 1] ^= 1;
+	try
+	{
+		GetOpt::OptionSchema corrupt(bytes.data(), bytes.size());
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+		return;
+	}
+	_fail_test("Schema: corruption rejected", "corrupt schema was accepted");
+}
+
+void testcorpus()
+{
+	testheader("FUZZ CORPUS");
+	for(auto& entry : FuzzModel::corpus())
+	{
+		_print_test_header_(string("Corpus: ") + entry.name);
+		auto c = entry.build();
+		if(!(FuzzModel::runGetopt(c) == FuzzModel::runModel(c)))
+			_fail_test(entry.name, "getopt disagrees with the reference model");
+		cout << "\t**" << c.args.size() << " args: ";
+		auto factor = FuzzModel::scalingFactor(c, &cout);
+		cout << endl;
+		if(factor > FuzzModel::SUPERLINEAR_FACTOR)
+			_fail_test(entry.name, "parse cost grows superlinearly (x", factor, " per byte over ", FuzzModel::SCALE, " repeats)");
+	}
+
+	// batchvalidate checks lines against a schema for getopt's defaults, so
+	// it has to agree with getopt on which lines those accept
+	_print_test_header_("Corpus: batchvalidate agrees with getopt");
+	FuzzModel::Values values;
+	ostringstream image;
+	GetOpt::writeOptionSchema(image, GetOpt::collectOptions(GETOPT_FUZZ_SPECS(values)).options);
+	auto bytes = image.str();
+	GetOpt::OptionSchema schema(bytes.data(), bytes.size());
+	vector<FuzzModel::FuzzCase> cases;
+	for(auto& entry : FuzzModel::corpus())
+		cases.push_back(entry.build());
+	// Options are matched in declaration order, not in the order given
+	for(auto& args : vector<vector<string>>{{"-n", "-c", "5"}, {"-n", "-b", "5"}, {"-n", "-a", "5"}, {"-N", "x", "-b"}
+		, {"--alpha", "--", "-a"}, {"-x", "-h"}, {"-c", "--count=2", "-n7"}})
+	{
+		FuzzModel::FuzzCase c;
+		c.args.push_back("this.exe");
+		c.args.insert(c.args.end(), args.begin(), args.end());
+		cases.push_back(c);
+	}
+	BatchValidate::Scratch scratch;
+	for(auto& c : cases)
+	{
+		c.config = 0;
+		GetOpt::CommandLine line;
+		for(auto& arg : c.args)
+			line.words.push_back(GetOpt::StringView(arg));
+		auto status = BatchValidate::validate(schema, line, scratch);
+		if((status == '.') != !FuzzModel::runGetopt(c).threw)
+			_fail_test("Corpus: batchvalidate agrees with getopt", "status ", status, " for "
+				, range_printer(c.args.begin(), c.args.begin() + std::min<size_t>(c.args.size(), 8)));
+	}
+}
+
 int main(int argc, char** argv)
 {
 	testbool();
 	teststring();
+	testusage();
+	testsink();
+	testsession();
+	testregistry();
+	testreload();
+	testfingerprint();
+	testtail();
+	testpositional();
+	testmove();
+	testhelpfirst();
+	testunits();
+	testutf8();
+	testsplit();
+	testchoice();
+	testcompletion();
+	testschema();
+	testcorpus();
 
 	cout << "Test harness complete." << endl;
 	return 0;
@@ -0,0 +1,91 @@
+/**
+ * harness.h
+ * Helpers shared by the test programs: running getopt on a list of args and
+ * checking what it leaves behind or throws.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#ifndef GETOPT_TEST_HARNESS_H
+#define GETOPT_TEST_HARNESS_H
+
+#include "../include/getopt.h"
+#include "../include/getoptdebug.h"
+#include "../depends/cpputils/printalgorithms.h"
+
+#include <iostream>
+using std::cout;
+using std::endl;
+#include <functional> 
+using std::function;
+#include <sstream>
+using std::ostringstream;
+#include <string>
+using std::string;
+#include <stdexcept>
+using std::logic_error;
+#include <vector>
+using std::vector;
+
+template<typename...Ts>
+void _fail_test(const string& testName, Ts&&...explanation_args)
+{
+	ostringstream error_message_stream;
+	writeln(error_message_stream, testName, " -- ", explanation_args...);
+	throw logic_error(error_message_stream.str());
+}
+
+inline void _print_test_header_(const string& testName)
+{
+	cout << "----" << testName << "----" << endl;
+}
+
+template<typename...GetOptArgs>
+GetOpt::GetOptResult _run_getopt(vector<string>& args, GetOptArgs&&...getOptArgs)
+{
+	cout << "\t**args: " << range_printer(args.begin(), args.end()) << endl;
+	GetOpt::printGetOptArgs(cout, "\t**getopt args", getOptArgs...);
+	return GetOpt::getopt(args, getOptArgs...);
+}
+
+typedef std::function<void()> SetUpFunction;
+typedef std::function<void(const string&)> TestValuesFunction;
+template<typename...GetOptArgs>
+void _test_success(const string& testName, vector<string> args, const vector<string>& expectedArgsAfter, SetUpFunction setUp, TestValuesFunction testParsedValues, GetOptArgs&&...getOptArgs)
+{
+	setUp();
+	_print_test_header_(testName);
+	try
+	{
+		auto result = _run_getopt(args, getOptArgs...);
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "****GetOpt Error: " << e.what() << endl;
+	}
+	cout << "\t**after: " << range_printer(args.begin(), args.end()) << endl;
+	cout.flush();
+	if(args != expectedArgsAfter)
+	{
+		_fail_test("expected args after getopt call to be \"", range_printer(expectedArgsAfter.begin(), expectedArgsAfter.end()));//, expectedArgsAfter.end()), "\", but is \"", range_printer(args.begin(), args.end()), "\"");
+	}
+	testParsedValues(testName);
+}
+
+template<typename...GetOptArgs>
+void _test_failure(const string& testName, vector<string> args, GetOptArgs&&...getOptArgs)
+{
+	_print_test_header_(testName);
+	try
+	{
+		auto result = _run_getopt(args, getOptArgs...);
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+		return;
+	}
+	throw logic_error(testName);
+}
+
+inline void testheader(const string& s) { cout << "==== " << s << " TEST ====" << endl; }
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * trace.cpp
+ * Tests of parse tracing. Tracing changes how getopt.h compiles, so these
+ * build on their own, leaving test/harness.cpp to test the default build.
+ * Authors: Erich Gubler, erichdongubler@gmail.com
+ */
+#define GETOPT_TRACE
+#include "harness.h"
+
+void testtrace()
+{
+	testheader("TRACE");
+	string file;
+	int number = 0;
+
+	_print_test_header_("Trace: decisions of a successful parse");
+	GetOpt::parseTrace().clear();
+	vector<string> args = {"this.exe", "input", "--file=a.txt", "-n", "3"};
+	GetOpt::getopt(args, "file|f", &file, "number|n", &number);
+	vector<GetOpt::TraceKind> expected = {GetOpt::TraceKind::begin, GetOpt::TraceKind::matched, GetOpt::TraceKind::value
+		, GetOpt::TraceKind::matched, GetOpt::TraceKind::value, GetOpt::TraceKind::finished};
+	auto& trace = GetOpt::parseTrace();
+	if(trace.size() != expected.size())
+		_fail_test("Trace: decisions of a successful parse", trace.size(), " events");
+	for(size_t i = 0; i < expected.size(); ++i)
+		if(trace[i].kind != expected[i] || trace[i].pending)
+			_fail_test("Trace: decisions of a successful parse", "unexpected event ", i);
+	if(trace[4].token != 4 || string(trace[4].text) != "3" || string(trace[4].spec) != "number|n")
+		_fail_test("Trace: decisions of a successful parse", "value event ", trace[4].token, ' ', trace[4].text);
+
+	_print_test_header_("Trace: failed conversion");
+	args = {"this.exe", "-n", "three", "--__getopt-trace"};
+	try
+	{
+		GetOpt::getopt(args, "file|f", &file, "number|n", &number);
+		_fail_test("Trace: failed conversion", "\"three\" converted");
+	}
+	catch(GetOpt::GetOptException& e)
+	{
+		cout << "\t**Caught expected error: " << e.what() << endl;
+	}
+	ostringstream dump;
+	GetOpt::dumpParseTrace(dump);
+	if(dump.str().find("[2] value \"three\" for number|n: conversion FAILED") == string::npos)
+		_fail_test("Trace: failed conversion", "dump was ", dump.str());
+
+	_print_test_header_("Trace: the ring keeps the latest events");
+	GetOpt::parseTrace().clear();
+	args.assign(1, "this.exe");
+	args.insert(args.end(), GETOPT_TRACE_SIZE, "-n1");
+	GetOpt::getopt(args, "number|n", &number);
+	if(trace.size() != GETOPT_TRACE_SIZE || trace[trace.size() - 1].kind != GetOpt::TraceKind::finished)
+		_fail_test("Trace: the ring keeps the latest events", trace.size(), " events");
+}
+
+int main()
+{
+	testtrace();
+
+	cout << "Trace tests complete." << endl;
+	return 0;
+}